@@ -0,0 +1,207 @@
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BINNING_X86 1
+#endif
+
+#ifndef _BINNING_
+#define _BINNING_
+
+/**
+ * Values to bin indices
+ *
+ * Bins are either num_bins equal bins over [lo, hi) or explicit ascending
+ * edges where bin i is [edges[i], edges[i + 1]). Three extra bins follow the
+ * regular ones: underflow (num_bins) for values below lo, overflow
+ * (num_bins + 1) for values at or above hi and nan (num_bins + 2), so every
+ * value gets an index in [0, total_bins()) and the result goes straight into
+ * the counting kernels or a concurrent_histogram.
+ *
+ * Equal bins are a scale, a clamp and a truncation, done four values at a
+ * time with AVX2 when the cpu has it. Explicit edges are searched in an
+ * Eytzinger (breadth first) copy of the edges: the loop has no data
+ * dependent branches and the first levels of the tree share cache lines.
+*/
+struct bin_edges {
+	std::vector<double> edges;
+	double lo = 0, hi = 0, scale = 0;
+	int num_bins = 0;
+
+	// edges in Eytzinger order from index 1, padded with +inf to a full tree
+	// of levels levels, and the sorted position of each
+	std::vector<double> tree;
+	std::vector<int> rank;
+	int levels = 0;
+
+	static bin_edges uniform(double lo, double hi, int num_bins) {
+		if (!(hi > lo) || num_bins < 1)
+			throw std::invalid_argument("Bin range needs lo < hi and at least one bin");
+		bin_edges e;
+		e.lo = lo;
+		e.hi = hi;
+		e.num_bins = num_bins;
+		e.scale = num_bins / (hi - lo);
+		return e;
+	}
+
+	static bin_edges from_edges(std::vector<double> edges) {
+		if (edges.size() < 2 || !std::is_sorted(edges.begin(), edges.end()) ||
+		    std::adjacent_find(edges.begin(), edges.end()) != edges.end())
+			throw std::invalid_argument("Bin edges have to be at least two strictly increasing values");
+		bin_edges e;
+		e.lo = edges.front();
+		e.hi = edges.back();
+		e.num_bins = edges.size() - 1;
+		e.edges = std::move(edges);
+
+		size_t m = e.edges.size();
+		while ((size_t(1) << e.levels) - 1 < m) e.levels++;
+		e.tree.assign(size_t(1) << e.levels, 0);
+		e.rank.assign(size_t(1) << e.levels, m); // rank[0]: no edge above the value
+		size_t next = 0;
+		e.build(next, 1);
+		return e;
+	}
+
+	int total_bins() const { return num_bins + 3; }
+	int underflow() const { return num_bins; }
+	int overflow() const { return num_bins + 1; }
+	int nan() const { return num_bins + 2; }
+
+	// bin of a single value
+	int operator()(double x) const {
+		int bin;
+		bins(&x, 1, &bin);
+		return bin;
+	}
+
+	// bins of n values
+	void bins(const double* values, size_t n, int* out) const {
+		if (!edges.empty())
+			bins_search(values, n, out);
+#ifdef BINNING_X86
+		else if (has_avx2())
+			bins_uniform_avx2(values, n, out);
+#endif
+		else
+			bins_uniform(values, n, out);
+	}
+
+private:
+	// in order traversal of the implicit tree fills it with the sorted edges
+	void build(size_t& next, size_t k) {
+		if (k >= tree.size()) return;
+		build(next, 2 * k);
+		if (next < edges.size()) {
+			tree[k] = edges[next];
+			rank[k] = next;
+		} else {
+			tree[k] = std::numeric_limits<double>::infinity();
+		}
+		next++;
+		build(next, 2 * k + 1);
+	}
+
+	int uniform_bin(double x) const {
+		double f = (x - lo) * scale;
+		f = f > 0.0 ? f : 0.0;
+		f = f < num_bins - 1 ? f : num_bins - 1;
+		int bin = int(f);
+		bin = x < lo ? underflow() : bin;
+		bin = x >= hi ? overflow() : bin;
+		return x != x ? nan() : bin;
+	}
+
+	void bins_uniform(const double* values, size_t n, int* out) const {
+		for (size_t i = 0; i < n; i++)
+			out[i] = uniform_bin(values[i]);
+	}
+
+	void bins_search(const double* values, size_t n, int* out) const {
+		const size_t m = edges.size();
+		const double* t = tree.data();
+		for (size_t i = 0; i < n; i++) {
+			double x = values[i];
+			size_t k = 1;
+			// the same number of steps for every value, nothing to mispredict
+			for (int level = 0; level < levels; level++) {
+				__builtin_prefetch(t + 8 * k);
+				k = 2 * k + (t[k] <= x);
+			}
+			// undo the right turns after the last left turn, leaves the first edge above x
+			k >>= __builtin_ffsll(~k);
+
+			int above = rank[k]; // edges <= x
+			int bin = above - 1;
+			bin = above == 0 ? underflow() : bin;
+			bin = above == (int)m ? overflow() : bin;
+			out[i] = x != x ? nan() : bin;
+		}
+	}
+
+#ifdef BINNING_X86
+	static bool has_avx2() {
+		static const bool avx2 = [] {
+			__builtin_cpu_init();
+			return __builtin_cpu_supports("avx2");
+		}();
+		return avx2;
+	}
+
+	__attribute__((target("avx2")))
+	void bins_uniform_avx2(const double* values, size_t n, int* out) const {
+		const __m256d vlo = _mm256_set1_pd(lo);
+		const __m256d vhi = _mm256_set1_pd(hi);
+		const __m256d vscale = _mm256_set1_pd(scale);
+		const __m256d zero = _mm256_setzero_pd();
+		const __m256d top = _mm256_set1_pd(num_bins - 1);
+		const __m256d under = _mm256_set1_pd(underflow());
+		const __m256d over = _mm256_set1_pd(overflow());
+		const __m256d not_a_number = _mm256_set1_pd(nan());
+
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4) {
+			__m256d x = _mm256_loadu_pd(values + i);
+			__m256d f = _mm256_mul_pd(_mm256_sub_pd(x, vlo), vscale);
+			// max returns the second operand for NaN, so NaN lanes become 0 here
+			f = _mm256_min_pd(_mm256_max_pd(f, zero), top);
+			f = _mm256_floor_pd(f);
+			f = _mm256_blendv_pd(f, under, _mm256_cmp_pd(x, vlo, _CMP_LT_OQ));
+			f = _mm256_blendv_pd(f, over, _mm256_cmp_pd(x, vhi, _CMP_GE_OQ));
+			f = _mm256_blendv_pd(f, not_a_number, _mm256_cmp_pd(x, x, _CMP_UNORD_Q));
+			_mm_storeu_si128((__m128i*)(out + i), _mm256_cvtpd_epi32(f));
+		}
+		bins_uniform(values + i, n - i, out + i);
+	}
+#endif
+};
+
+// "lo:hi" for equal bins, "e0,e1,...,en" for explicit edges
+inline bin_edges parse_edges(const std::string& range, const std::string& edges, int num_bins) {
+	if (!edges.empty()) {
+		std::vector<double> values;
+		size_t pos = 0;
+		while (pos <= edges.size()) {
+			size_t comma = std::min(edges.find(',', pos), edges.size());
+			values.push_back(std::stod(edges.substr(pos, comma - pos)));
+			pos = comma + 1;
+		}
+		return bin_edges::from_edges(values);
+	}
+	if (!range.empty()) {
+		size_t colon = range.find(':');
+		if (colon == std::string::npos)
+			throw std::invalid_argument("Range has to be lo:hi: " + range);
+		return bin_edges::uniform(std::stod(range.substr(0, colon)), std::stod(range.substr(colon + 1)), num_bins);
+	}
+	// one bin per integer value, like the generated samples
+	return bin_edges::uniform(0, num_bins, num_bins);
+}
+
+#endif
@@ -0,0 +1,320 @@
+#include <vector>
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <chrono>
+
+#ifndef _CONCURRENT_HISTOGRAM_
+#define _CONCURRENT_HISTOGRAM_
+
+/**
+ * Histogram that many threads count into at once
+ *
+ * Every thread calls add(thread_id, bin), merge() returns the totals once the
+ * threads are done. How the counts are kept is up to the strategy:
+ *
+ *   shared_atomics  - one atomic counter per bin, every add is a fetch_add on
+ *                     a line that all threads write to
+ *   padded_shards   - every thread owns a copy of the bins on cache lines of
+ *                     its own, merge sums the copies
+ *   private_buffers - like padded_shards, but every flush_interval adds a
+ *                     thread moves its counts into shared atomics, so the
+ *                     totals build up while the threads are still running
+ *   live_shards     - like padded_shards, but snapshot() reads consistent
+ *                     totals while the threads keep adding
+ *
+ * A thread calls done(thread_id) after its last add, and quiesce(thread_id)
+ * before it pauses adding for a while: live_shards snapshots wait for every
+ * thread that is neither done nor quiesced to make its next add.
+*/
+
+// size of the lines the shards are padded to
+constexpr size_t cache_line = 64;
+
+// a cache line worth of counters, the shards are arrays of these
+struct alignas(cache_line) counter_line {
+	uint64_t counts[cache_line / sizeof(uint64_t)] = {};
+};
+
+// per thread shards of num_bins counters, no two threads share a line
+struct shards {
+	size_t lines_per_shard;
+	std::vector<counter_line> lines;
+
+	shards(int num_bins, int num_threads)
+		: lines_per_shard((num_bins * sizeof(uint64_t) + cache_line - 1) / cache_line),
+		  lines(lines_per_shard * num_threads) { }
+
+	uint64_t* operator[](int thread_id) {
+		return lines[thread_id * lines_per_shard].counts;
+	}
+};
+
+struct shared_atomics {
+	std::vector<std::atomic<uint64_t>> data;
+
+	shared_atomics(int num_bins, int /*num_threads*/) : data(num_bins) {
+		for (auto& atom : data)
+			atom.store(0, std::memory_order_relaxed);
+	}
+
+	void add(int /*thread_id*/, int bin) {
+		data[bin].fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void quiesce(int /*thread_id*/) { }
+
+	void done(int /*thread_id*/) { }
+
+	std::vector<uint64_t> merge() {
+		std::vector<uint64_t> totals(data.size());
+		for (size_t i = 0; i < data.size(); i++)
+			totals[i] = data[i].load(std::memory_order_relaxed);
+		return totals;
+	}
+};
+
+struct padded_shards {
+	int num_bins;
+	int num_threads;
+	shards local;
+
+	padded_shards(int num_bins, int num_threads) : num_bins(num_bins), num_threads(num_threads), local(num_bins, num_threads) { }
+
+	void add(int thread_id, int bin) {
+		local[thread_id][bin]++;
+	}
+
+	void quiesce(int /*thread_id*/) { }
+
+	void done(int /*thread_id*/) { }
+
+	// only after the threads are done
+	std::vector<uint64_t> merge() {
+		std::vector<uint64_t> totals(num_bins, 0);
+		for (int t = 0; t < num_threads; t++) {
+			uint64_t* counts = local[t];
+			for (int i = 0; i < num_bins; i++)
+				totals[i] += counts[i];
+		}
+		return totals;
+	}
+};
+
+struct private_buffers {
+	static constexpr int flush_interval = 1 << 16;
+
+	int num_bins;
+	int num_threads;
+	shards local;
+	std::vector<uint64_t> pending; // adds since the last flush, per thread (padded as well)
+	std::vector<std::atomic<uint64_t>> data;
+
+	private_buffers(int num_bins, int num_threads)
+		: num_bins(num_bins), num_threads(num_threads), local(num_bins, num_threads),
+		  pending(num_threads * (cache_line / sizeof(uint64_t)), 0), data(num_bins)
+	{
+		for (auto& atom : data)
+			atom.store(0, std::memory_order_relaxed);
+	}
+
+	void add(int thread_id, int bin) {
+		local[thread_id][bin]++;
+		if (++pending[thread_id * (cache_line / sizeof(uint64_t))] == flush_interval)
+			flush(thread_id);
+	}
+
+	// the counts of a pausing thread show up in the totals right away
+	void quiesce(int thread_id) {
+		flush(thread_id);
+	}
+
+	void done(int /*thread_id*/) { }
+
+	// moves a thread's counts into the shared totals
+	void flush(int thread_id) {
+		uint64_t* counts = local[thread_id];
+		for (int i = 0; i < num_bins; i++) {
+			if (counts[i] != 0) {
+				data[i].fetch_add(counts[i], std::memory_order_relaxed);
+				counts[i] = 0;
+			}
+		}
+		pending[thread_id * (cache_line / sizeof(uint64_t))] = 0;
+	}
+
+	// only after the threads are done
+	std::vector<uint64_t> merge() {
+		for (int t = 0; t < num_threads; t++)
+			flush(t);
+
+		std::vector<uint64_t> totals(num_bins);
+		for (int i = 0; i < num_bins; i++)
+			totals[i] = data[i].load(std::memory_order_relaxed);
+		return totals;
+	}
+};
+
+/**
+ * Shards that can be read while the threads are adding
+ *
+ * Every thread has two buffers of bins and adds into the one picked by the
+ * parity of the global epoch. snapshot() advances the epoch and waits until
+ * every thread has acknowledged it, which a thread does on its next add by
+ * switching buffers. From then on nobody writes the buffers of the old
+ * epoch, the reader adds them to its running totals and clears them for the
+ * epoch after next. The result is a consistent cut: every thread contributes
+ * exactly the samples it added before it saw the new epoch.
+ *
+ * On the hot path a thread only loads the epoch, a line that changes once
+ * per snapshot, and increments a counter of its own. It stores to its own
+ * acknowledgement only when the epoch has changed. No locks, no
+ * read-modify-write atomics. Only the reader side takes a mutex, so
+ * snapshots are taken one at a time.
+ *
+ * A thread that stops adding can not acknowledge anything, so it has to say
+ * so first: quiesce() and done() mark it idle, snapshot() skips idle threads
+ * and the next add acknowledges the epoch again. Threads count as idle until
+ * their first add. A thread that stops adding without either call stalls
+ * snapshot() until it adds again.
+*/
+struct live_shards {
+	static constexpr uint64_t idle = ~uint64_t(0);
+
+	// what a thread publishes to the reader, and its cached view of the epoch
+	struct alignas(cache_line) writer_state {
+		std::atomic<uint64_t> seen{idle};
+		uint64_t epoch = idle;
+		uint64_t* counts = nullptr;
+	};
+
+	int num_bins;
+	int num_threads;
+	shards buffers; // buffers[2 * thread_id + epoch % 2]
+	std::vector<writer_state> writers;
+	alignas(cache_line) std::atomic<uint64_t> epoch{0};
+
+	// reader side
+	std::mutex reader;
+	std::vector<uint64_t> totals;
+	uint64_t snapshots = 0;
+	double snapshot_seconds = 0;
+
+	live_shards(int num_bins, int num_threads)
+		: num_bins(num_bins), num_threads(num_threads), buffers(num_bins, 2 * num_threads),
+		  writers(num_threads), totals(num_bins, 0) { }
+
+	void add(int thread_id, int bin) {
+		writer_state& w = writers[thread_id];
+		if (epoch.load(std::memory_order_acquire) != w.epoch)
+			acknowledge(thread_id);
+		w.counts[bin]++;
+	}
+
+	// until its next add the thread is skipped by snapshot()
+	void quiesce(int thread_id) {
+		writer_state& w = writers[thread_id];
+		w.epoch = idle;
+		w.seen.store(idle, std::memory_order_seq_cst);
+	}
+
+	void done(int thread_id) {
+		quiesce(thread_id);
+	}
+
+	// totals of all samples added before the call, the threads keep going
+	std::vector<uint64_t> snapshot() {
+		std::lock_guard<std::mutex> lock(reader);
+		auto start = std::chrono::steady_clock::now();
+
+		uint64_t old = epoch.load(std::memory_order_relaxed);
+		epoch.store(old + 1, std::memory_order_seq_cst);
+
+		for (int t = 0; t < num_threads; t++) {
+			uint64_t seen;
+			while ((seen = writers[t].seen.load(std::memory_order_seq_cst)) != old + 1 && seen != idle)
+				std::this_thread::yield();
+		}
+
+		// the old buffers are ours now, the release store of the next epoch hands them back
+		for (int t = 0; t < num_threads; t++)
+			collect(buffers[2 * t + (old & 1)]);
+
+		snapshots++;
+		snapshot_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		return totals;
+	}
+
+	// only after the threads are done
+	std::vector<uint64_t> merge() {
+		std::lock_guard<std::mutex> lock(reader);
+		for (int i = 0; i < 2 * num_threads; i++)
+			collect(buffers[i]);
+		return totals;
+	}
+
+private:
+	/**
+	 * Switches the thread to the buffer of the current epoch and tells the
+	 * reader, everything added to the old buffer happens before the reader
+	 * sees it. The epoch is checked again after the store: a reader that
+	 * advanced it in between may have seen the thread idle and skipped it,
+	 * then the thread has to take the next buffer instead.
+	*/
+	void acknowledge(int thread_id) {
+		writer_state& w = writers[thread_id];
+		uint64_t e = epoch.load(std::memory_order_seq_cst);
+		for (;;) {
+			w.seen.store(e, std::memory_order_seq_cst);
+			uint64_t now = epoch.load(std::memory_order_seq_cst);
+			if (now == e) break;
+			e = now;
+		}
+		w.epoch = e;
+		w.counts = buffers[2 * thread_id + (e & 1)];
+	}
+
+	void collect(uint64_t* counts) {
+		for (int i = 0; i < num_bins; i++) {
+			totals[i] += counts[i];
+			counts[i] = 0;
+		}
+	}
+};
+
+template<typename Strategy>
+struct concurrent_histogram {
+	Strategy strategy;
+
+	concurrent_histogram(int num_bins, int num_threads) : strategy(num_bins, num_threads) { }
+
+	void add(int thread_id, int bin) {
+		strategy.add(thread_id, bin);
+	}
+
+	void quiesce(int thread_id) {
+		strategy.quiesce(thread_id);
+	}
+
+	void done(int thread_id) {
+		strategy.done(thread_id);
+	}
+
+	std::vector<uint64_t> merge() {
+		return strategy.merge();
+	}
+};
+
+inline void print(const std::vector<uint64_t>& totals, std::ostream& str) {
+	size_t total = 0;
+	for (size_t i = 0; i < totals.size(); ++i) {
+		str << i << ":" << totals[i] << "\n";
+		total += totals[i];
+	}
+	str << "total:" << total << "\n";
+}
+
+#endif
@@ -1,23 +1,175 @@
 #include <iostream>
 #include <string>
-#include <random>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
 
+#ifndef _HELPERS_
+#define _HELPERS_
 
+/**
+ * Counter-based random numbers (Philox4x32-10)
+ *
+ * Every block of four samples is a function of the key and its block number
+ * only, so sample i of the stream is the same no matter which thread draws
+ * it. A worker seeks to the global index of its first sample and the
+ * histogram comes out bit-identical for any number of threads.
+ *
+ * Samples are made batch_blocks blocks at a time in plain lane loops that
+ * the compiler turns into SIMD multiplies. They are mapped to [0, max) with
+ * a multiply and shift instead of a division, the bias of that is at most
+ * max / 2^32.
+*/
 struct generator {
-    // let's generate random number like this for consistent tests
-    generator(const int& max) : dist(0, max-1) {	}
+    static constexpr int batch_blocks = 16;
+    static constexpr int batch = 4 * batch_blocks;
+
+    generator(const int& max, uint64_t first_sample = 0, uint64_t seed = 0x2545F4914F6CDD1DULL)
+        : max(max), key0(uint32_t(seed)), key1(uint32_t(seed >> 32)) {
+        seek(first_sample);
+    }
+
     int operator()() {
-        return dist(engine);
+        if (pos == batch) refill();
+        return buffer[pos++];
+    }
+
+    // jumps to sample index of the stream
+    void seek(uint64_t index) {
+        block = index / 4;
+        refill();
+        pos = index % 4;
     }
+
+    // writes the next count samples to out
+    void fill(int* out, size_t count) {
+        while (count > 0) {
+            if (pos == batch) refill();
+            size_t n = std::min<size_t>(count, batch - pos);
+            for (size_t i = 0; i < n; i++)
+                out[i] = buffer[pos + i];
+            pos += n;
+            out += n;
+            count -= n;
+        }
+    }
+
 private:
     int max;
-    std::minstd_rand engine; 
-    std::uniform_int_distribution<int> dist;
+    uint32_t key0, key1;
+    uint64_t block = 0; // first block of the next refill
+    int pos = batch;
+    int buffer[batch];
+
+    // ten Philox rounds on batch_blocks consecutive blocks
+    void refill() {
+        uint32_t c0[batch_blocks], c1[batch_blocks], c2[batch_blocks], c3[batch_blocks];
+        for (int l = 0; l < batch_blocks; l++) {
+            c0[l] = uint32_t(block + l);
+            c1[l] = uint32_t((block + l) >> 32);
+            c2[l] = 0;
+            c3[l] = 0;
+        }
+
+        uint32_t k0 = key0, k1 = key1;
+        for (int round = 0; round < 10; round++) {
+            for (int l = 0; l < batch_blocks; l++) {
+                uint64_t p0 = uint64_t(0xD2511F53) * c0[l];
+                uint64_t p1 = uint64_t(0xCD9E8D57) * c2[l];
+                uint32_t n0 = uint32_t(p1 >> 32) ^ c1[l] ^ k0;
+                uint32_t n2 = uint32_t(p0 >> 32) ^ c3[l] ^ k1;
+                c1[l] = uint32_t(p1);
+                c3[l] = uint32_t(p0);
+                c0[l] = n0;
+                c2[l] = n2;
+            }
+            k0 += 0x9E3779B9;
+            k1 += 0xBB67AE85;
+        }
+
+        // lane l holds samples 4 * (block + l) to 4 * (block + l) + 3
+        for (int l = 0; l < batch_blocks; l++) {
+            buffer[4 * l + 0] = int((uint64_t(c0[l]) * uint32_t(max)) >> 32);
+            buffer[4 * l + 1] = int((uint64_t(c1[l]) * uint32_t(max)) >> 32);
+            buffer[4 * l + 2] = int((uint64_t(c2[l]) * uint32_t(max)) >> 32);
+            buffer[4 * l + 3] = int((uint64_t(c3[l]) * uint32_t(max)) >> 32);
+        }
+
+        block += batch_blocks;
+        pos = 0;
+    }
+};
+
+// samples a worker draws between two progress updates
+constexpr int64_t progress_chunk = int64_t(1) << 22;
+
+/**
+ * Progress of a long run
+ *
+ * Workers add their samples after every chunk. With an interval > 0 a
+ * reporter thread prints the percentage done and the current samples/s to
+ * stderr every interval seconds, so stdout still ends with the time.
+*/
+struct progress {
+    progress(int64_t total, double interval) : total(total), start(std::chrono::steady_clock::now()) {
+        if (interval > 0)
+            reporter = std::thread([this, interval] { report(interval); });
+    }
+
+    ~progress() {
+        stop();
+    }
+
+    void add(int64_t samples) {
+        done.fetch_add(samples, std::memory_order_relaxed);
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopped = true;
+        }
+        cv.notify_all();
+        if (reporter.joinable()) reporter.join();
+    }
+
+private:
+    int64_t total;
+    std::atomic<int64_t> done{0};
+    std::chrono::steady_clock::time_point start;
+    std::thread reporter;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stopped = false;
+
+    void report(double interval) {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!cv.wait_for(lock, std::chrono::duration<double>(interval), [this] { return stopped; })) {
+            int64_t samples = done.load(std::memory_order_relaxed);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cerr << "progress: " << 100.0 * samples / total << "% (" << samples << " samples, "
+                      << samples / seconds << " samples/s)" << std::endl;
+        }
+    }
 };
 
+// sample counts, also in scientific notation (1e11)
+int64_t parse_count(const std::string& arg) {
+    size_t end;
+    int64_t count = std::stoll(arg, &end);
+    if (end != arg.size())
+        count = int64_t(std::stod(arg));
+    return count;
+}
+
 // Parsing arguments
-void parse_args(int argc, char **argv, int& num_threads, int &num_bins, int &sample_size, int& print_level) {
-    std::string usage("Usage: --num-threads <integer> --num-bins <integer> --samlpe-size <integer> --print-level <integer>");
+void parse_args(int argc, char **argv, int& num_threads, int &num_bins, int64_t &sample_size, int& print_level, double& progress_interval) {
+    std::string usage("Usage: --num-threads <integer> --num-bins <integer> --samlpe-size <integer> --print-level <integer> --progress <seconds>");
 
     for (int i = 1; i < argc; ++i) {
         if ( std::string(argv[i]).compare("--num-threads") == 0 ) {
@@ -25,12 +177,16 @@ void parse_args(int argc, char **argv, int& num_threads, int &num_bins, int &sam
         } else if ( std::string(argv[i]).compare("--num-bins") == 0 ) {
             num_bins=std::stoi(argv[++i]);
         } else if ( std::string(argv[i]).compare("--sample-size") == 0 ) {
-            sample_size=std::stoi(argv[++i]);
+            sample_size=parse_count(argv[++i]);
         } else if ( std::string(argv[i]).compare("--print-level") == 0 ) {
             print_level=std::stoi(argv[++i]);
+        } else if ( std::string(argv[i]).compare("--progress") == 0 ) {
+            progress_interval=std::stod(argv[++i]);
         } else if (  std::string(argv[i]).compare("--help") == 0 ) {
             std::cout << usage << std::endl;
             exit(-1);
         }
     }
-};
\ No newline at end of file
+};
+
+#endif
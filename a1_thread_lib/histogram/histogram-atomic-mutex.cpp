@@ -11,7 +11,7 @@
 using namespace std;
 
 struct histogram {
-	std::vector<std::atomic<int>> data;
+	std::vector<std::atomic<uint64_t>> data;
 	
 	histogram(int count) : data(count){ 
 		for (auto& atom : data) {
@@ -23,14 +23,14 @@ struct histogram {
 		data[i].fetch_add(1, std::memory_order_relaxed);
 	}
 
-	int get(int i)	{
+	uint64_t get(int i)	{
 		return data[i].load(std::memory_order_relaxed);
 	}
 
 	void print(std::ostream& str) {
 		size_t total = 0;
 		for (size_t i = 0; i < data.size(); ++i){ 
-			int cnt = data[i].load(std::memory_order_relaxed);
+			uint64_t cnt = data[i].load(std::memory_order_relaxed);
 
 			str << i << ":" << cnt << "\n";
 			total += cnt;
@@ -40,15 +40,18 @@ struct histogram {
 	}
 };
 
-void worker(int begin, int end, histogram& h, int num_bins) 
+void worker(int64_t begin, int64_t end, histogram& h, int num_bins, progress& prog) 
 {
 
-	generator gen(num_bins);
+	generator gen(num_bins, begin);
 
-	for (size_t i = begin; i < end; i++) {
-		int next = gen();
-		h.add(next);
-		
+	for (int64_t chunk = begin; chunk < end; chunk += progress_chunk) {
+		int64_t chunk_end = std::min(chunk + progress_chunk, end);
+		for (int64_t i = chunk; i < chunk_end; i++) {
+			int next = gen();
+			h.add(next);
+		}
+		prog.add(chunk_end - chunk);
 	}
 	
 }
@@ -56,42 +59,47 @@ void worker(int begin, int end, histogram& h, int num_bins)
 int main(int argc, char **argv)
 {
 	int num_bins = 10;
-	int sample_count = 30000000;
+	int64_t sample_count = 30000000;
 
 	int num_threads = std::thread::hardware_concurrency();
 	int print_level = 2; // 0 exec time only, 1 histogram, 2 histogram + config
-	parse_args(argc, argv, num_threads, num_bins, sample_count, print_level);
+	double progress_interval = 0; // seconds between progress reports, 0 for none
+	parse_args(argc, argv, num_threads, num_bins, sample_count, print_level, progress_interval);
 	
 	histogram h(num_bins);
 	std::vector<std::thread> thrds;
 
 	// this calculates how many samples per thread will be evenly distributed
 	// alongside all used threads
-	int samp_in_thrd = sample_count / num_threads;
+	int64_t samp_in_thrd = sample_count / num_threads;
 
 	auto t1 = chrono::high_resolution_clock::now();
+	progress prog(sample_count, progress_interval);
 
 	//worker(sample_count, h, num_bins);
 
 	// distributing the subtasks to each future thread 
-	for (size_t i = 0; i < num_threads; i++) {
-		int begin = i * samp_in_thrd;
-		int end = (i + 1) * samp_in_thrd;
+	for (int i = 0; i < num_threads; i++) {
+		int64_t begin = i * samp_in_thrd;
+		int64_t end = (i + 1) * samp_in_thrd;
 
 		if (i == num_threads-1)
 			end =sample_count;
 		
 
-		thrds.emplace_back(worker, begin, end, std::ref(h), num_bins);	
+		thrds.emplace_back(worker, begin, end, std::ref(h), num_bins, std::ref(prog));	
 	}
 
 	// creating and waiting for the completion of all the threads
 	for (auto& t : thrds)
 		t.join();
+	prog.stop();
 
 	auto t2 = chrono::high_resolution_clock::now();
+	double seconds = chrono::duration<double>(t2 - t1).count();
 
 	if ( print_level >= 2 ) std::cout << "Bins: " << num_bins << ", sample size: " << sample_count << ", threads: " << num_threads << endl;
 	if ( print_level >= 1 ) h.print(std::cout);
-	std::cout << chrono::duration<double>(t2 - t1).count() << endl;
+	if ( print_level >= 1 ) std::cout << "samples/s: " << sample_count / seconds << endl;
+	std::cout << seconds << endl;
 }
\ No newline at end of file
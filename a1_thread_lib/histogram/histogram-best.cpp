@@ -7,30 +7,30 @@
 #include <thread>
 
 #include "helpers.hpp"
+#include "histogram_kernels.hpp"
+#include "large_histogram.hpp"
 
 using namespace std;
 
+// plain counters, so the partitioned strategy can count straight into the
+// bins its threads own, the dense workers add to them atomically
 struct histogram {
-	std::vector<std::atomic<int>> data;
+	std::vector<uint64_t> data;
 	
-	histogram(int count) : data(count){ 
-		for (auto& atom : data) {
-            atom.store(0, std::memory_order_relaxed);
-        }
-	}
+	histogram(int count) : data(count, 0) { }
 
-	void add(int i) {
-		data[i].fetch_add(1, std::memory_order_relaxed);
+	void add(int i, uint64_t count = 1) {
+		__atomic_fetch_add(&data[i], count, __ATOMIC_RELAXED);
 	}
 
-	int get(int i)	{
-		return data[i].load(std::memory_order_relaxed);
+	uint64_t get(int i)	{
+		return data[i];
 	}
 
 	void print(std::ostream& str) {
 		size_t total = 0;
 		for (size_t i = 0; i < data.size(); ++i){ 
-			int cnt = data[i].load(std::memory_order_relaxed);
+			uint64_t cnt = data[i];
 
 			str << i << ":" << cnt << "\n";
 			total += cnt;
@@ -40,24 +40,25 @@ struct histogram {
 	}
 };
 
-void worker(int begin, int end, histogram& h, int num_bins) 
+void worker(int64_t begin, int64_t end, histogram& h, int num_bins, progress& prog) 
 {
 	//long count = 0.0;
-	std::vector<int> local_counts(num_bins, 0);
+	std::vector<uint64_t> local_counts(num_bins, 0);
 
-	generator gen(num_bins);
+	// starts at the global index of the first sample, so any thread count gives the same counts
+	generator gen(num_bins, begin);
 
 	//while (begin++ < end) {
-	for (size_t i = begin; i < end; i++) {
-		int bin = gen();
-		//h.add(next);
-		local_counts[bin]++;
-		//count++;
+	for (int64_t chunk = begin; chunk < end; chunk += progress_chunk) {
+		int64_t chunk_end = std::min(chunk + progress_chunk, end);
+		// interleaved sub-histograms, specialized for common bin counts
+		count_samples(gen, chunk_end - chunk, num_bins, local_counts.data());
+		prog.add(chunk_end - chunk);
 	}
 
 	// adding the counts later enables less atomic operations per work of a thread
-	for (size_t i = 0; i < num_bins; i++){
-		h.data[i].fetch_add(local_counts[i], std::memory_order_relaxed);
+	for (int i = 0; i < num_bins; i++){
+		h.add(i, local_counts[i]);
 	}
 	
 }
@@ -65,42 +66,59 @@ void worker(int begin, int end, histogram& h, int num_bins)
 int main(int argc, char **argv)
 {
 	int num_bins = 10;
-	int sample_count = 30000000;
+	int64_t sample_count = 30000000;
 
 	int num_threads = std::thread::hardware_concurrency();
 	int print_level = 2; // 0 exec time only, 1 histogram, 2 histogram + config
-	parse_args(argc, argv, num_threads, num_bins, sample_count, print_level);
+	double progress_interval = 0; // seconds between progress reports, 0 for none
+	parse_args(argc, argv, num_threads, num_bins, sample_count, print_level, progress_interval);
+	std::string strategy_arg = "auto"; // dense, sparse, partitioned or auto by bin count
+	for (int i = 1; i < argc; ++i) {
+		if ( std::string(argv[i]).compare("--strategy") == 0 )
+			strategy_arg = argv[++i];
+	}
+	bin_strategy strategy = strategy_arg == "auto" ? choose_strategy(num_bins, num_threads, sample_count) : parse_strategy(strategy_arg);
 	
 	histogram h(num_bins);
 	std::vector<std::thread> thrds;
 
 	// this calculates how many samples per thread will be evenly distributed
 	// alongside all used threads
-	int samp_in_thrd = sample_count / num_threads;
+	int64_t samp_in_thrd = sample_count / num_threads;
 
 	auto t1 = chrono::high_resolution_clock::now();
+	progress prog(sample_count, progress_interval);
 
 	//worker(sample_count, h, num_bins);
 
+	// many bins, the threads fill the bins through a large histogram strategy
+	if (strategy == bin_strategy::sparse)
+		count_sparse(num_threads, num_bins, sample_count, prog, [&](int bin, uint64_t count) { h.data[bin] = count; });
+	else if (strategy == bin_strategy::partitioned)
+		count_partitioned(num_threads, num_bins, sample_count, prog, h.data.data());
+
 	// distributing the subtasks to each future thread 
-	for (size_t i = 0; i < num_threads; i++) {
-		int begin = i * samp_in_thrd;
-		int end = (i + 1) * samp_in_thrd;
+	for (int i = 0; strategy == bin_strategy::dense && i < num_threads; i++) {
+		int64_t begin = i * samp_in_thrd;
+		int64_t end = (i + 1) * samp_in_thrd;
 
 		if (i == num_threads-1)
 			end =sample_count;
 		
 
-		thrds.emplace_back(worker, begin, end, std::ref(h), num_bins);	
+		thrds.emplace_back(worker, begin, end, std::ref(h), num_bins, std::ref(prog));	
 	}
 
 	// creating and waiting for the completion of all the threads
 	for (auto& t : thrds)
 		t.join();
+	prog.stop();
 
 	auto t2 = chrono::high_resolution_clock::now();
+	double seconds = chrono::duration<double>(t2 - t1).count();
 
-	if ( print_level >= 2 ) std::cout << "Bins: " << num_bins << ", sample size: " << sample_count << ", threads: " << num_threads << endl;
+	if ( print_level >= 2 ) std::cout << "Bins: " << num_bins << ", sample size: " << sample_count << ", threads: " << num_threads << ", strategy: " << strategy_name(strategy) << endl;
 	if ( print_level >= 1 ) h.print(std::cout);
-	std::cout << chrono::duration<double>(t2 - t1).count() << endl;
+	if ( print_level >= 1 ) std::cout << "samples/s: " << sample_count / seconds << endl;
+	std::cout << seconds << endl;
 }
\ No newline at end of file
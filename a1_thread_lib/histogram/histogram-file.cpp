@@ -0,0 +1,131 @@
+#include <vector>
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <string>
+
+#include "helpers.hpp"
+#include "histogram_kernels.hpp"
+#include "binning.hpp"
+#include "input_file.hpp"
+
+using namespace std;
+
+// bins the values of one chunk into counts, including the underflow, overflow and nan bins
+void worker(const mapped_file& file, std::pair<size_t, size_t> chunk, input_format format, int column,
+            const bin_edges& edges, std::vector<uint64_t>& counts, uint64_t& invalid)
+{
+	constexpr int batch = 4096;
+	uint64_t lines_invalid = 0;
+
+	count_dispatch([&](auto&& count) {
+		double values[batch];
+		int bins[batch];
+		size_t n = 0;
+		for_each_value(file.data + chunk.first, file.data + chunk.second, format, column, [&](double x) {
+			values[n++] = x;
+			if (n == batch) {
+				edges.bins(values, n, bins);
+				count(bins, n);
+				n = 0;
+			}
+		}, lines_invalid);
+		if (n > 0) {
+			edges.bins(values, n, bins);
+			count(bins, n);
+		}
+	}, edges.total_bins(), counts.data());
+
+	invalid = lines_invalid;
+}
+
+// every thread sums a slice of the bins over all threads' counts into the first
+void merge(std::vector<std::vector<uint64_t>>& counts, int num_threads)
+{
+	size_t num_bins = counts[0].size();
+	std::vector<std::thread> thrds;
+	for (int t = 0; t < num_threads; t++) {
+		thrds.emplace_back([&counts, t, num_threads, num_bins] {
+			for (size_t b = num_bins * t / num_threads; b < num_bins * (t + 1) / num_threads; b++)
+				for (size_t s = 1; s < counts.size(); s++)
+					counts[0][b] += counts[s][b];
+		});
+	}
+	for (auto& t : thrds)
+		t.join();
+}
+
+/**
+ * Histogram of a column of a file
+ *
+ * --input <file> --format int32|int64|float64|text [--column <n>]
+ * [--range <lo>:<hi> | --edges <e0,e1,...>] plus the usual --num-threads,
+ * --num-bins and --print-level. Without range or edges every integer value
+ * in [0, num_bins) gets its own bin.
+*/
+int main(int argc, char **argv)
+{
+	int num_bins = 10;
+	int64_t sample_count = 0; // unused, the file decides
+
+	int num_threads = std::thread::hardware_concurrency();
+	int print_level = 2; // 0 exec time only, 1 histogram, 2 histogram + config
+	double progress_interval = 0;
+	parse_args(argc, argv, num_threads, num_bins, sample_count, print_level, progress_interval);
+
+	std::string input, format_name = "float64", range, edges_list;
+	int column = 0;
+	for (int i = 1; i < argc; ++i) {
+		if ( std::string(argv[i]).compare("--input") == 0 ) {
+			input = argv[++i];
+		} else if ( std::string(argv[i]).compare("--format") == 0 ) {
+			format_name = argv[++i];
+		} else if ( std::string(argv[i]).compare("--column") == 0 ) {
+			column = std::stoi(argv[++i]);
+		} else if ( std::string(argv[i]).compare("--range") == 0 ) {
+			range = argv[++i];
+		} else if ( std::string(argv[i]).compare("--edges") == 0 ) {
+			edges_list = argv[++i];
+		}
+	}
+	if (input.empty()) {
+		std::cout << "Usage: --input <file> --format int32|int64|float64|text [--column <n>] [--range <lo>:<hi> | --edges <e0,e1,...>]" << std::endl;
+		exit(-1);
+	}
+
+	input_format format = parse_format(format_name);
+	bin_edges edges = parse_edges(range, edges_list, num_bins);
+	num_bins = edges.num_bins;
+
+	auto t1 = chrono::high_resolution_clock::now();
+
+	mapped_file file(input);
+	auto chunks = split_records(file, format, num_threads);
+	std::vector<std::vector<uint64_t>> counts(num_threads, std::vector<uint64_t>(edges.total_bins(), 0));
+	std::vector<uint64_t> invalid(num_threads, 0);
+
+	std::vector<std::thread> thrds;
+	for (int i = 0; i < num_threads; i++)
+		thrds.emplace_back(worker, std::cref(file), chunks[i], format, column, std::cref(edges), std::ref(counts[i]), std::ref(invalid[i]));
+	for (auto& t : thrds)
+		t.join();
+
+	merge(counts, num_threads);
+
+	auto t2 = chrono::high_resolution_clock::now();
+	double seconds = chrono::duration<double>(t2 - t1).count();
+
+	uint64_t values = 0, lines_invalid = 0;
+	for (int b = 0; b < num_bins; b++) values += counts[0][b];
+	for (uint64_t i : invalid) lines_invalid += i;
+
+	if ( print_level >= 2 ) std::cout << "Input: " << input << " (" << file.size << " bytes, " << format_name << "), bins: " << num_bins << ", threads: " << num_threads << endl;
+	if ( print_level >= 1 ) {
+		for (int b = 0; b < num_bins; b++) std::cout << b << ":" << counts[0][b] << "\n";
+		std::cout << "total:" << values << "\n";
+		std::cout << "underflow: " << counts[0][edges.underflow()] << ", overflow: " << counts[0][edges.overflow()]
+		          << ", nan: " << counts[0][edges.nan()] << ", invalid: " << lines_invalid << endl;
+		std::cout << "MB/s: " << file.size / seconds / 1e6 << endl;
+	}
+	std::cout << seconds << endl;
+}
@@ -0,0 +1,144 @@
+#include <vector>
+#include <iostream>
+#include <random>
+#include <chrono>
+#include <numeric>
+#include <thread>
+#include <string>
+#include <atomic>
+#include <type_traits>
+
+#include "helpers.hpp"
+#include "concurrent_histogram.hpp"
+
+using namespace std;
+
+template<typename Strategy>
+void worker(int thread_id, int64_t begin, int64_t end, concurrent_histogram<Strategy>& h, int num_bins, progress& prog)
+{
+	generator gen(num_bins, begin);
+
+	for (int64_t chunk = begin; chunk < end; chunk += progress_chunk) {
+		int64_t chunk_end = std::min(chunk + progress_chunk, end);
+		for (int64_t i = chunk; i < chunk_end; i++)
+			h.add(thread_id, gen());
+		prog.add(chunk_end - chunk);
+	}
+	// live_shards snapshots wait for every thread that has not called done() or
+	// quiesce(), the workers never pause, so done() at the end is all they need
+	h.done(thread_id);
+}
+
+// what the reader thread of a live_shards run saw
+struct snapshot_stats {
+	uint64_t count = 0;
+	double seconds = 0; // spent inside snapshot()
+	bool consistent = true; // no bin ever went down and the totals only grew
+};
+
+// fills a histogram with every thread, returns the time it took including the merge.
+// With stats a reader thread snapshots a live_shards histogram every snapshot_interval seconds meanwhile.
+template<typename Strategy>
+double run(int num_threads, int num_bins, int64_t sample_count, double progress_interval, std::vector<uint64_t>& totals,
+           double snapshot_interval = 0, snapshot_stats* stats = nullptr)
+{
+	concurrent_histogram<Strategy> h(num_bins, num_threads);
+	std::vector<std::thread> thrds;
+	int64_t samp_in_thrd = sample_count / num_threads;
+
+	auto t1 = chrono::high_resolution_clock::now();
+	progress prog(sample_count, progress_interval);
+
+	for (int i = 0; i < num_threads; i++) {
+		int64_t begin = i * samp_in_thrd;
+		int64_t end = i == num_threads - 1 ? sample_count : (i + 1) * samp_in_thrd;
+		thrds.emplace_back(worker<Strategy>, i, begin, end, std::ref(h), num_bins, std::ref(prog));
+	}
+
+	std::atomic<bool> stop{false};
+	std::thread reader;
+	if constexpr (std::is_same<Strategy, live_shards>::value) {
+		if (stats) {
+			reader = std::thread([&] {
+				std::vector<uint64_t> previous(num_bins, 0);
+				while (!stop.load(std::memory_order_relaxed)) {
+					std::vector<uint64_t> current = h.strategy.snapshot();
+					for (int b = 0; b < num_bins; b++)
+						if (current[b] < previous[b]) stats->consistent = false;
+					previous.swap(current);
+					if (snapshot_interval > 0)
+						std::this_thread::sleep_for(std::chrono::duration<double>(snapshot_interval));
+				}
+			});
+		}
+	}
+
+	for (auto& t : thrds)
+		t.join();
+	prog.stop();
+
+	stop = true;
+	if (reader.joinable()) {
+		reader.join();
+		if constexpr (std::is_same<Strategy, live_shards>::value) {
+			stats->count = h.strategy.snapshots;
+			stats->seconds = h.strategy.snapshot_seconds;
+		}
+	}
+
+	totals = h.merge();
+
+	auto t2 = chrono::high_resolution_clock::now();
+	return chrono::duration<double>(t2 - t1).count();
+}
+
+/**
+ * Runs every strategy of concurrent_histogram with the same threads, bins and
+ * samples and reports which one is fastest. The last line is the best time.
+*/
+int main(int argc, char **argv)
+{
+	int num_bins = 10;
+	int64_t sample_count = 30000000;
+
+	int num_threads = std::thread::hardware_concurrency();
+	int print_level = 2; // 0 exec time only, 1 times per strategy, 2 times + config
+	double progress_interval = 0; // seconds between progress reports, 0 for none
+	parse_args(argc, argv, num_threads, num_bins, sample_count, print_level, progress_interval);
+	double snapshot_interval = 0.001; // seconds between the snapshots of the live_shards reader, 0 back to back
+	for (int i = 1; i < argc; ++i) {
+		if ( std::string(argv[i]).compare("--snapshot-interval") == 0 )
+			snapshot_interval = std::stod(argv[++i]) / 1000;
+	}
+
+	if ( print_level >= 2 ) cout << "Bins: " << num_bins << ", sample size: " << sample_count << ", threads: " << num_threads << endl;
+
+	std::vector<std::string> names = {"shared_atomics", "padded_shards", "private_buffers", "live_shards"};
+	std::vector<double> times;
+	std::vector<uint64_t> totals;
+
+	times.push_back(run<shared_atomics>(num_threads, num_bins, sample_count, progress_interval, totals));
+	times.push_back(run<padded_shards>(num_threads, num_bins, sample_count, progress_interval, totals));
+	times.push_back(run<private_buffers>(num_threads, num_bins, sample_count, progress_interval, totals));
+	times.push_back(run<live_shards>(num_threads, num_bins, sample_count, progress_interval, totals));
+
+	// live_shards again, with a reader taking snapshots while the threads add
+	snapshot_stats stats;
+	double live_time = run<live_shards>(num_threads, num_bins, sample_count, progress_interval, totals, snapshot_interval, &stats);
+	bool complete = std::accumulate(totals.begin(), totals.end(), uint64_t(0)) == (uint64_t)sample_count;
+
+	size_t best = 0;
+	for (size_t i = 0; i < times.size(); i++) {
+		if ( print_level >= 1 ) cout << names[i] << ": " << times[i] << " (" << sample_count / times[i] << " samples/s)" << endl;
+		if (times[i] < times[best]) best = i;
+	}
+
+	if ( print_level >= 1 ) {
+		cout << "live_shards + snapshots: " << live_time << " (" << sample_count / live_time << " samples/s), "
+		     << stats.count << " snapshots (" << stats.count / live_time << "/s, "
+		     << (stats.count ? 1e6 * stats.seconds / stats.count : 0) << " us each), overhead "
+		     << 100 * (live_time / times[3] - 1) << "%" << (stats.consistent && complete ? "" : ", INCONSISTENT") << endl;
+		cout << "fastest: " << names[best] << endl;
+	}
+	cout << times[best] << endl;
+}
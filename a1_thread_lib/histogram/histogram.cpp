@@ -9,7 +9,7 @@
 using namespace std;
 
 struct histogram {
-	std::vector<int> data;
+	std::vector<uint64_t> data;
 	
 	histogram(int count) : data(count) { }
 
@@ -17,47 +17,52 @@ struct histogram {
 		++data[i];
 	}
 
-	int& get(int i)	{
+	uint64_t& get(int i)	{
 		return data[i];
 	}
 
 	void print(std::ostream& str) {
 		for (size_t i = 0; i < data.size(); ++i) str << i << ":" << data[i] << "\n";
-		str << "total:" << accumulate(data.begin(), data.end(), 0) << "\n";
+		str << "total:" << accumulate(data.begin(), data.end(), uint64_t(0)) << "\n";
 	}
 };
 
-void worker(int sample_count, histogram& h, int num_bins) 
+void worker(int64_t sample_count, histogram& h, int num_bins, progress& prog) 
 {
-	long count = 0.0;
-
 	generator gen(num_bins);
 
-	while (sample_count--) {
-		int next = gen();
-		h.add(next);
-		count++;
+	// in chunks, so the progress reporter sees the samples done
+	for (int64_t begin = 0; begin < sample_count; begin += progress_chunk) {
+		int64_t chunk = std::min(progress_chunk, sample_count - begin);
+		for (int64_t i = 0; i < chunk; i++)
+			h.add(gen());
+		prog.add(chunk);
 	}
 }
 
 int main(int argc, char **argv)
 {
 	int num_bins = 10;
-	int sample_count = 30000000;
+	int64_t sample_count = 30000000;
 
 	int num_threads = 1;//std::thread::hardware_concurrency();
 	int print_level = 2; // 0 exec time only, 1 histogram, 2 histogram + config
-	parse_args(argc, argv, num_threads, num_bins, sample_count, print_level);
+	double progress_interval = 0; // seconds between progress reports, 0 for none
+	parse_args(argc, argv, num_threads, num_bins, sample_count, print_level, progress_interval);
 	
 	histogram h(num_bins);
 
 	auto t1 = chrono::high_resolution_clock::now();
 
-	worker(sample_count, h, num_bins);
+	progress prog(sample_count, progress_interval);
+	worker(sample_count, h, num_bins, prog);
+	prog.stop();
 
 	auto t2 = chrono::high_resolution_clock::now();
+	double seconds = chrono::duration<double>(t2 - t1).count();
 
 	if ( print_level >= 2 ) cout << "Bins: " << num_bins << ", sample size: " << sample_count << ", threads: " << num_threads << endl;
 	if ( print_level >= 1 ) h.print(cout);
-	cout << chrono::duration<double>(t2 - t1).count() << endl;
+	if ( print_level >= 1 ) cout << "samples/s: " << sample_count / seconds << endl;
+	cout << seconds << endl;
 }
\ No newline at end of file
@@ -0,0 +1,178 @@
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <cstdint>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef _INPUT_FILE_
+#define _INPUT_FILE_
+
+/**
+ * Reading real data into the histogram
+ *
+ * The file is mapped into memory and split into one chunk per thread on
+ * record boundaries. Every thread parses its chunk straight out of the
+ * mapping, nothing is copied or read through a stream. Binary files are raw
+ * little endian int32, int64 or float64 values. Text files have one record
+ * per line, with --column the value is taken from that comma separated field.
+*/
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "binary input is read as little endian");
+
+enum class input_format { int32, int64, float64, text };
+
+inline input_format parse_format(const std::string& name) {
+	if (name == "int32") return input_format::int32;
+	if (name == "int64") return input_format::int64;
+	if (name == "float64") return input_format::float64;
+	if (name == "text" || name == "csv") return input_format::text;
+	throw std::invalid_argument("Unknown input format: " + name);
+}
+
+// bytes per record of a binary format, 0 for text
+inline size_t record_size(input_format format) {
+	switch (format) {
+		case input_format::int32: return 4;
+		case input_format::int64:
+		case input_format::float64: return 8;
+		default: return 0;
+	}
+}
+
+// read only mapping of a whole file
+struct mapped_file {
+	const char* data = nullptr;
+	size_t size = 0;
+
+	mapped_file(const std::string& filename) {
+		int fd = open(filename.c_str(), O_RDONLY);
+		if (fd < 0)
+			throw std::runtime_error("Could not open " + filename);
+
+		struct stat st;
+		if (fstat(fd, &st) != 0) {
+			close(fd);
+			throw std::runtime_error("Could not stat " + filename);
+		}
+		size = st.st_size;
+
+		if (size > 0) {
+			void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (mapping == MAP_FAILED) {
+				close(fd);
+				throw std::runtime_error("Could not map " + filename);
+			}
+			// advice values are not flags, one call each; both are only hints
+			(void)madvise(mapping, size, MADV_SEQUENTIAL);
+			(void)madvise(mapping, size, MADV_WILLNEED);
+			data = static_cast<const char*>(mapping);
+		}
+		close(fd);
+	}
+
+	~mapped_file() {
+		if (data) munmap(const_cast<char*>(data), size);
+	}
+
+	mapped_file(const mapped_file&) = delete;
+	mapped_file& operator=(const mapped_file&) = delete;
+};
+
+/**
+ * Splits [0, size) into parts chunks that start and end on record
+ * boundaries: a multiple of the record size for binary files, the start of a
+ * line for text. A trailing partial binary record is left out.
+*/
+inline std::vector<std::pair<size_t, size_t>> split_records(const mapped_file& file, input_format format, int parts) {
+	size_t record = record_size(format);
+	size_t size = record ? file.size - file.size % record : file.size;
+
+	std::vector<size_t> bounds(parts + 1, size);
+	bounds[0] = 0;
+	for (int i = 1; i < parts; i++) {
+		size_t pos = size * i / parts;
+		if (record) {
+			pos -= pos % record;
+		} else {
+			// to the start of the next line
+			const void* newline = pos < size ? memchr(file.data + pos, '\n', size - pos) : nullptr;
+			pos = newline ? static_cast<const char*>(newline) - file.data + 1 : size;
+		}
+		bounds[i] = std::max(pos, bounds[i - 1]);
+	}
+
+	std::vector<std::pair<size_t, size_t>> chunks;
+	for (int i = 0; i < parts; i++)
+		chunks.emplace_back(bounds[i], bounds[i + 1]);
+	return chunks;
+}
+
+/**
+ * Calls f(value) for every record in [begin, end) of a chunk. Text lines
+ * whose field does not parse as a number count as invalid, empty lines are
+ * skipped.
+*/
+template<typename F>
+void for_each_value(const char* begin, const char* end, input_format format, int column, F&& f, uint64_t& invalid) {
+	switch (format) {
+		case input_format::int32:
+			for (const char* p = begin; p < end; p += 4) {
+				int32_t v;
+				memcpy(&v, p, 4);
+				f(double(v));
+			}
+			break;
+		case input_format::int64:
+			for (const char* p = begin; p < end; p += 8) {
+				int64_t v;
+				memcpy(&v, p, 8);
+				f(double(v));
+			}
+			break;
+		case input_format::float64:
+			for (const char* p = begin; p < end; p += 8) {
+				double v;
+				memcpy(&v, p, 8);
+				f(v);
+			}
+			break;
+		case input_format::text:
+			for (const char* p = begin; p < end; ) {
+				const char* line_end = static_cast<const char*>(memchr(p, '\n', end - p));
+				if (!line_end) line_end = end;
+				if (line_end == p || (line_end - p == 1 && *p == '\r')) {
+					p = line_end + 1;
+					continue;
+				}
+
+				const char* field = p;
+				for (int c = 0; c < column && field; c++) {
+					field = static_cast<const char*>(memchr(field, ',', line_end - field));
+					if (field) field++;
+				}
+
+				if (field) {
+					while (field < line_end && (*field == ' ' || *field == '\t')) field++;
+					double v;
+					auto result = std::from_chars(field, line_end, v);
+					if (result.ec == std::errc())
+						f(v);
+					else
+						invalid++;
+				} else {
+					invalid++;
+				}
+				p = line_end + 1;
+			}
+			break;
+	}
+}
+
+#endif
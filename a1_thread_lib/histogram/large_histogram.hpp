@@ -0,0 +1,261 @@
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <string>
+#include <cstdint>
+#include <algorithm>
+
+#include "helpers.hpp"
+
+#ifndef _LARGE_HISTOGRAM_
+#define _LARGE_HISTOGRAM_
+
+/**
+ * Strategies for histograms with many bins
+ *
+ *   dense       - every thread counts into private bins, fine while
+ *                 threads x bins fits into the caches
+ *   sparse      - every thread counts into a hash table of the bins it has
+ *                 seen, the tables are merged pairwise in a parallel tree.
+ *                 Wins when a thread sees few of the bins, either because
+ *                 the data is skewed or because there are fewer samples
+ *                 than bins.
+ *   partitioned - the caller's array of bins split into cache sized
+ *                 partitions. The threads draw a round of samples, sort
+ *                 them by partition (radix on the high bits of the bin) and
+ *                 then every thread counts the samples of the partitions it
+ *                 owns. No private bins and nothing to merge.
+*/
+enum class bin_strategy { dense, sparse, partitioned };
+
+// up to this many bins every thread keeps dense private bins
+constexpr int dense_bins = 1 << 15;
+
+inline bin_strategy parse_strategy(const std::string& name) {
+	if (name == "sparse") return bin_strategy::sparse;
+	if (name == "partitioned") return bin_strategy::partitioned;
+	return bin_strategy::dense;
+}
+
+inline const char* strategy_name(bin_strategy strategy) {
+	switch (strategy) {
+		case bin_strategy::sparse: return "sparse";
+		case bin_strategy::partitioned: return "partitioned";
+		default: return "dense";
+	}
+}
+
+// waits until all threads arrived
+struct thread_barrier {
+	int count;
+	int waiting = 0;
+	int generation = 0;
+	std::mutex mutex;
+	std::condition_variable cv;
+
+	thread_barrier(int count) : count(count) { }
+
+	void wait() {
+		std::unique_lock<std::mutex> lock(mutex);
+		int gen = generation;
+		if (++waiting == count) {
+			waiting = 0;
+			generation++;
+			cv.notify_all();
+		} else {
+			cv.wait(lock, [&] { return gen != generation; });
+		}
+	}
+};
+
+// open addressing hash table from bin to count
+struct sparse_bins {
+	std::vector<int> keys;
+	std::vector<uint64_t> values;
+	size_t used = 0;
+	int bits;
+
+	sparse_bins(int bits = 10) : keys(size_t(1) << bits, -1), values(size_t(1) << bits, 0), bits(bits) { }
+
+	size_t slot(int bin) const {
+		return (uint32_t(bin) * 0x9E3779B1u) >> (32 - bits);
+	}
+
+	void add(int bin, uint64_t count = 1) {
+		size_t mask = keys.size() - 1;
+		size_t i = slot(bin);
+		while (keys[i] != bin && keys[i] != -1)
+			i = (i + 1) & mask;
+		if (keys[i] == -1) {
+			keys[i] = bin;
+			used++;
+		}
+		values[i] += count;
+		if (used * 2 > keys.size())
+			grow();
+	}
+
+	void merge(const sparse_bins& other) {
+		for (size_t i = 0; i < other.keys.size(); i++)
+			if (other.keys[i] != -1)
+				add(other.keys[i], other.values[i]);
+	}
+
+	void grow() {
+		sparse_bins bigger(bits + 1);
+		bigger.merge(*this);
+		*this = std::move(bigger);
+	}
+};
+
+/**
+ * Picks the strategy for num_bins from the bin count and, above dense_bins,
+ * from how many distinct bins a probe of the first samples hits
+*/
+inline bin_strategy choose_strategy(int num_bins, int num_threads, int64_t sample_count) {
+	if (num_bins <= dense_bins)
+		return bin_strategy::dense;
+
+	int64_t probe = std::min<int64_t>(sample_count, 1 << 16);
+	generator gen(num_bins);
+	sparse_bins seen;
+	for (int64_t i = 0; i < probe; i++)
+		seen.add(gen());
+
+	// skewed data, or a thread sees only a small part of the bins
+	if (seen.used * 16 < (size_t)probe || sample_count / num_threads < num_bins / 8)
+		return bin_strategy::sparse;
+	return bin_strategy::partitioned;
+}
+
+// samples [begin, end) of thread t, the same split as the dense workers
+inline void thread_range(int t, int num_threads, int64_t sample_count, int64_t& begin, int64_t& end) {
+	int64_t samp_in_thrd = sample_count / num_threads;
+	begin = t * samp_in_thrd;
+	end = t == num_threads - 1 ? sample_count : (t + 1) * samp_in_thrd;
+}
+
+/**
+ * Counts with per thread hash tables, emit(bin, count) is called once for
+ * every bin that was hit, from several threads but never twice for a bin
+*/
+template<typename Emit>
+void count_sparse(int num_threads, int num_bins, int64_t sample_count, progress& prog, Emit emit) {
+	std::vector<sparse_bins> tables(num_threads);
+	thread_barrier barrier(num_threads);
+
+	auto body = [&](int t) {
+		int64_t begin, end;
+		thread_range(t, num_threads, sample_count, begin, end);
+
+		generator gen(num_bins, begin);
+		int bins[generator::batch];
+		for (int64_t chunk = begin; chunk < end; chunk += progress_chunk) {
+			int64_t chunk_end = std::min(chunk + progress_chunk, end);
+			for (int64_t i = chunk; i < chunk_end; i += generator::batch) {
+				int n = std::min<int64_t>(generator::batch, chunk_end - i);
+				gen.fill(bins, n);
+				for (int j = 0; j < n; j++)
+					tables[t].add(bins[j]);
+			}
+			prog.add(chunk_end - chunk);
+		}
+
+		// tree merge, after log2(threads) rounds table 0 holds everything
+		for (int step = 1; step < num_threads; step *= 2) {
+			barrier.wait();
+			if (t % (2 * step) == 0 && t + step < num_threads) {
+				tables[t].merge(tables[t + step]);
+				tables[t + step] = sparse_bins(1);
+			}
+		}
+		barrier.wait();
+
+		// every thread emits a slice of the merged table
+		const sparse_bins& all = tables[0];
+		size_t first = all.keys.size() * t / num_threads;
+		size_t last = all.keys.size() * (t + 1) / num_threads;
+		for (size_t i = first; i < last; i++)
+			if (all.keys[i] != -1)
+				emit(all.keys[i], all.values[i]);
+	};
+
+	std::vector<std::thread> thrds;
+	for (int t = 1; t < num_threads; t++)
+		thrds.emplace_back(body, t);
+	body(0);
+	for (auto& t : thrds)
+		t.join();
+}
+
+/**
+ * Adds the samples to counts[0..num_bins) with radix partitioned rounds. A
+ * partition is counted by the same thread in every round, so the counts are
+ * plain increments and need no copy or merge afterwards.
+*/
+inline void count_partitioned(int num_threads, int num_bins, int64_t sample_count, progress& prog, uint64_t* counts) {
+	constexpr int64_t round_size = 1 << 18;
+
+	// partitions of 2^12 to 2^15 bins, at least four per thread if the bins allow
+	int shift = 12;
+	while (shift < 15 && (int64_t(num_bins) >> (shift + 1)) >= 4 * num_threads)
+		shift++;
+	int partitions = (num_bins + (1 << shift) - 1) >> shift;
+
+	std::vector<std::vector<int>> scattered(num_threads, std::vector<int>(round_size));
+	std::vector<std::vector<int64_t>> offsets(num_threads, std::vector<int64_t>(partitions + 1));
+	thread_barrier barrier(num_threads);
+
+	// the last thread has the longest range
+	int64_t last_begin, last_end;
+	thread_range(num_threads - 1, num_threads, sample_count, last_begin, last_end);
+	int64_t rounds = (last_end - last_begin + round_size - 1) / round_size;
+
+	auto body = [&](int t) {
+		int64_t begin, end;
+		thread_range(t, num_threads, sample_count, begin, end);
+		int first_partition = int64_t(partitions) * t / num_threads;
+		int last_partition = int64_t(partitions) * (t + 1) / num_threads;
+
+		generator gen(num_bins, begin);
+		std::vector<int> samples(round_size);
+		std::vector<int64_t> pos(partitions);
+		std::vector<int64_t>& offset = offsets[t];
+
+		for (int64_t r = 0; r < rounds; r++) {
+			int64_t n = std::clamp<int64_t>(end - (begin + r * round_size), 0, round_size);
+			gen.fill(samples.data(), n);
+
+			// counting sort of the round by partition
+			std::fill(offset.begin(), offset.end(), 0);
+			for (int64_t i = 0; i < n; i++)
+				offset[(samples[i] >> shift) + 1]++;
+			for (int p = 0; p < partitions; p++)
+				offset[p + 1] += offset[p];
+			std::copy(offset.begin(), offset.end() - 1, pos.begin());
+			for (int64_t i = 0; i < n; i++)
+				scattered[t][pos[samples[i] >> shift]++] = samples[i];
+			prog.add(n);
+
+			barrier.wait();
+
+			// the samples of every thread that fall into my partitions
+			for (int p = first_partition; p < last_partition; p++)
+				for (int s = 0; s < num_threads; s++)
+					for (int64_t i = offsets[s][p]; i < offsets[s][p + 1]; i++)
+						counts[scattered[s][i]]++;
+
+			barrier.wait();
+		}
+	};
+
+	std::vector<std::thread> thrds;
+	for (int t = 1; t < num_threads; t++)
+		thrds.emplace_back(body, t);
+	body(0);
+	for (auto& t : thrds)
+		t.join();
+}
+
+#endif
@@ -0,0 +1,195 @@
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cmath>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <exception>
+#include <stdexcept>
+
+#include "mandelbrot.hpp"
+#include "worker_pool.hpp"
+
+#ifndef _ANIMATION_
+#define _ANIMATION_
+
+/**
+ * Zoom videos as a sequence of frames along a keyframe path
+ *
+ * The frames are rendered by one persistent worker pool and pipelined: while
+ * the pool computes the escape data of frame N+1, a writer thread colorizes
+ * frame N and writes it to disk. With a reuse tolerance, pixels of a frame
+ * that fall on a pixel of the previous one copy its escape data instead of
+ * iterating again.
+*/
+namespace animation {
+
+    // view at a point in time, the center as decimal strings like set_view
+    struct Keyframe {
+        double time;
+        std::string center_re;
+        std::string center_im;
+        double scale;
+    };
+
+    struct Stats {
+        int frames = 0;
+        size_t pixels_inside = 0; // summed over all frames
+        size_t reused_pixels = 0;
+        double compute_time = 0; // pool busy with escape data, the writer overlaps it
+    };
+
+    // one keyframe per line "time center_re center_im scale", # starts a comment
+    inline std::vector<Keyframe> load_keyframes(const std::string& filename) {
+        std::ifstream in(filename);
+        if (!in)
+            throw std::runtime_error("Could not open " + filename);
+
+        std::vector<Keyframe> keyframes;
+        std::string line;
+        while (std::getline(in, line)) {
+            line = line.substr(0, line.find('#'));
+            std::istringstream fields(line);
+            Keyframe key;
+            if (fields >> key.time >> key.center_re >> key.center_im >> key.scale)
+                keyframes.push_back(key);
+        }
+
+        if (keyframes.empty())
+            throw std::runtime_error("No keyframes in " + filename);
+        for (size_t i = 1; i < keyframes.size(); i++) {
+            if (keyframes[i].time <= keyframes[i - 1].time)
+                throw std::runtime_error("Keyframe times have to increase: " + filename);
+        }
+        return keyframes;
+    }
+
+    /**
+     * View at the given time. The scale is interpolated geometrically, so the
+     * zoom speed stays constant, and the center moves in step with the scale,
+     * so the target of a zoom stays in place on screen. Equal centers keep
+     * all their digits, others are interpolated in double.
+    */
+    inline Keyframe interpolate(const std::vector<Keyframe>& keyframes, double time) {
+        if (time <= keyframes.front().time) return keyframes.front();
+        if (time >= keyframes.back().time) return keyframes.back();
+
+        size_t i = 1;
+        while (keyframes[i].time < time) i++;
+        const Keyframe& a = keyframes[i - 1];
+        const Keyframe& b = keyframes[i];
+
+        double t = (time - a.time) / (b.time - a.time);
+        double scale = a.scale * std::pow(b.scale / a.scale, t);
+        double w = a.scale == b.scale ? t : (a.scale - scale) / (a.scale - b.scale);
+
+        auto mix = [&](const std::string& from, const std::string& to) {
+            if (from == to) return from;
+            std::ostringstream out;
+            out << std::setprecision(17) << std::stod(from) + w * (std::stod(to) - std::stod(from));
+            return out.str();
+        };
+
+        return {time, mix(a.center_re, b.center_re), mix(a.center_im, b.center_im), scale};
+    }
+
+    inline std::string frame_name(const std::string& prefix, int frame) {
+        std::ostringstream name;
+        name << prefix << std::setw(4) << std::setfill('0') << frame << ".ppm";
+        return name.str();
+    }
+
+    /**
+     * Renders num_frames frames evenly spaced from the first to the last
+     * keyframe into prefix0000.ppm, prefix0001.ppm, ...
+     *
+     * Two iteration buffers alternate: the pool fills one while the writer
+     * colorizes the other, and a buffer is only reused once its frame has
+     * been written. reuse_tolerance is the largest offset (in pixels) at which
+     * a pixel still copies the previous frame's data, negative disables it.
+     * Reuse is approximate: a copied pixel is off by up to the tolerance, which
+     * near the boundary of the set can give it a different escape count than a
+     * render of the frame on its own. Off by default for that reason.
+    */
+    inline Stats render(Mandelbrot& mb, const std::vector<Keyframe>& keyframes, int num_frames, int height, int width,
+                        int max_iterations, bool smooth, const std::string& prefix, int num_threads, double reuse_tolerance)
+    {
+        WorkerPool pool(num_threads);
+        mb.set_pool(&pool);
+
+        IterationBuffer buffers[2] = {IterationBuffer(height, width, max_iterations, smooth),
+                                      IterationBuffer(height, width, max_iterations, smooth)};
+        Palette palette = Palette::gradient();
+
+        std::mutex frame_mutex;
+        std::condition_variable frame_cv;
+        int computed = -1; // last frame with escape data
+        int written = -1;  // last frame on disk
+        std::exception_ptr write_error;
+
+        std::thread writer([&]() {
+            Image image(height, width);
+            for (int f = 0; f < num_frames; f++) {
+                {
+                    std::unique_lock<std::mutex> lock(frame_mutex);
+                    frame_cv.wait(lock, [&]() { return computed >= f; });
+                }
+
+                try {
+                    colorize(buffers[f % 2], image, palette);
+                    image.save_to_ppm(frame_name(prefix, f));
+                } catch (...) {
+                    if (!write_error) write_error = std::current_exception();
+                }
+
+                std::lock_guard<std::mutex> guard(frame_mutex);
+                written = f;
+                frame_cv.notify_all();
+            }
+        });
+
+        Stats stats;
+        Viewport previous_view;
+        double start = keyframes.front().time;
+        double length = keyframes.back().time - start;
+
+        for (int f = 0; f < num_frames; f++) {
+            IterationBuffer& buffer = buffers[f % 2];
+            {
+                std::unique_lock<std::mutex> lock(frame_mutex);
+                frame_cv.wait(lock, [&]() { return written >= f - 2; });
+            }
+
+            Keyframe key = interpolate(keyframes, start + (num_frames > 1 ? length * f / (num_frames - 1) : 0));
+            mb.set_view(key.center_re, key.center_im, key.scale);
+            if (f > 0 && reuse_tolerance >= 0)
+                mb.reuse_from(buffers[(f - 1) % 2], previous_view, reuse_tolerance);
+
+            auto t1 = std::chrono::high_resolution_clock::now();
+            stats.pixels_inside += mb.compute_iterations(buffer, num_threads);
+            auto t2 = std::chrono::high_resolution_clock::now();
+
+            stats.compute_time += std::chrono::duration<double>(t2 - t1).count();
+            stats.reused_pixels += mb.get_reused_pixels();
+            stats.frames++;
+            previous_view = mb.get_view();
+
+            std::lock_guard<std::mutex> guard(frame_mutex);
+            computed = f;
+            frame_cv.notify_all();
+        }
+
+        writer.join();
+        mb.set_pool(nullptr);
+
+        if (write_error)
+            std::rethrow_exception(write_error);
+        return stats;
+    }
+}
+
+#endif
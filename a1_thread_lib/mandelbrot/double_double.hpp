@@ -0,0 +1,56 @@
+#include <cmath>
+
+#ifndef _DOUBLE_DOUBLE_
+#define _DOUBLE_DOUBLE_
+
+/**
+ * Double-double number: the unevaluated sum hi + lo of two doubles with
+ * |lo| <= ulp(hi) / 2, about 106 bits of mantissa. Enough for views down
+ * to roughly 1e-29 before the perturbation mode is needed.
+*/
+struct DoubleDouble {
+    double hi = 0;
+    double lo = 0;
+
+    DoubleDouble() { }
+    DoubleDouble(double hi, double lo = 0) : hi(hi), lo(lo) { }
+
+    // exact a + b = s + e
+    static DoubleDouble two_sum(double a, double b) {
+        double s = a + b;
+        double bb = s - a;
+        double e = (a - (s - bb)) + (b - bb);
+        return {s, e};
+    }
+
+    // exact a + b = s + e for |a| >= |b|
+    static DoubleDouble quick_two_sum(double a, double b) {
+        double s = a + b;
+        return {s, b - (s - a)};
+    }
+
+    friend DoubleDouble operator+(const DoubleDouble& a, const DoubleDouble& b) {
+        DoubleDouble s = two_sum(a.hi, b.hi);
+        return quick_two_sum(s.hi, s.lo + a.lo + b.lo);
+    }
+
+    friend DoubleDouble operator-(const DoubleDouble& a) {
+        return {-a.hi, -a.lo};
+    }
+
+    friend DoubleDouble operator-(const DoubleDouble& a, const DoubleDouble& b) {
+        return a + (-b);
+    }
+
+    friend DoubleDouble operator*(const DoubleDouble& a, const DoubleDouble& b) {
+        double p = a.hi * b.hi;
+        double e = std::fma(a.hi, b.hi, -p);
+        return quick_two_sum(p, e + (a.hi * b.lo + a.lo * b.hi));
+    }
+};
+
+inline double to_double(float v) { return v; }
+inline double to_double(double v) { return v; }
+inline double to_double(const DoubleDouble& v) { return v.hi + v.lo; }
+
+#endif
@@ -0,0 +1,168 @@
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cctype>
+#include <cmath>
+#include <stdexcept>
+
+#ifndef _FIXED_POINT_
+#define _FIXED_POINT_
+
+/**
+ * Software multi-precision fixed point number
+ *
+ * Sign and magnitude, the magnitude is stored in 32 bit limbs, least
+ * significant first: limbs[size-1] is the integer part, all others are the
+ * fraction. Only meant for the reference orbit of the perturbation renderer,
+ * where all values stay small (|z| <= 4 before escaping), so the integer part
+ * never overflows and a fixed number of fraction bits gives the precision.
+*/
+struct Fixed {
+    bool negative = false;
+    std::vector<uint32_t> limbs;
+
+    explicit Fixed(int num_limbs = 4) : limbs(num_limbs, 0) { }
+
+    int size() const {
+        return limbs.size();
+    }
+
+    // parses plain decimal notation, e.g. "-0.7436438870371587047521915"
+    static Fixed from_string(const std::string& str, int num_limbs) {
+        Fixed result(num_limbs);
+        size_t pos = 0;
+
+        if (pos < str.size() && (str[pos] == '-' || str[pos] == '+'))
+            result.negative = str[pos++] == '-';
+
+        uint64_t integer = 0;
+        for (; pos < str.size() && str[pos] != '.'; pos++) {
+            if (!isdigit(str[pos])) throw std::invalid_argument("Invalid number: " + str);
+            integer = integer * 10 + (str[pos] - '0');
+        }
+
+        // fraction digits from the last to the first: f = (f + digit) / 10
+        for (size_t i = str.size(); i > pos + 1; i--) {
+            char c = str[i - 1];
+            if (!isdigit(c)) throw std::invalid_argument("Invalid number: " + str);
+
+            result.limbs[num_limbs - 1] = c - '0';
+            uint64_t rem = 0;
+            for (int k = num_limbs - 1; k >= 0; k--) {
+                uint64_t cur = (rem << 32) | result.limbs[k];
+                result.limbs[k] = cur / 10;
+                rem = cur % 10;
+            }
+        }
+
+        result.limbs[num_limbs - 1] = integer;
+        return result;
+    }
+
+    // exact, every double with |v| < 2^32 fits into enough limbs
+    static Fixed from_double(double v, int num_limbs) {
+        Fixed result(num_limbs);
+        result.negative = v < 0;
+        double mag = std::fabs(v);
+        for (int k = num_limbs - 1; k >= 0; k--) {
+            double limb = std::floor(mag);
+            result.limbs[k] = (uint32_t)limb;
+            mag = (mag - limb) * 0x1p32;
+        }
+        return result;
+    }
+
+    double to_double() const {
+        double value = 0;
+        double scale = 1;
+        for (int k = size() - 1; k >= 0 && k >= size() - 4; k--) {
+            value += limbs[k] * scale;
+            scale *= 0x1p-32;
+        }
+        return negative ? -value : value;
+    }
+
+    friend Fixed operator-(Fixed a) {
+        a.negative = !a.negative;
+        return a;
+    }
+
+    friend Fixed operator+(const Fixed& a, const Fixed& b) {
+        if (a.negative == b.negative) {
+            Fixed result = add_magnitude(a, b);
+            result.negative = a.negative;
+            return result;
+        }
+
+        // different signs, subtract the smaller magnitude from the larger
+        if (compare_magnitude(a, b) >= 0) {
+            Fixed result = sub_magnitude(a, b);
+            result.negative = a.negative;
+            return result;
+        }
+        Fixed result = sub_magnitude(b, a);
+        result.negative = b.negative;
+        return result;
+    }
+
+    friend Fixed operator-(const Fixed& a, const Fixed& b) {
+        return a + (-b);
+    }
+
+    friend Fixed operator*(const Fixed& a, const Fixed& b) {
+        int n = a.size();
+        std::vector<uint64_t> product(2 * n, 0);
+
+        // schoolbook multiplication of the magnitudes
+        for (int i = 0; i < n; i++) {
+            uint64_t carry = 0;
+            for (int j = 0; j < n; j++) {
+                uint64_t cur = product[i + j] + (uint64_t)a.limbs[i] * b.limbs[j] + carry;
+                product[i + j] = cur & 0xFFFFFFFF;
+                carry = cur >> 32;
+            }
+            product[i + n] += carry;
+        }
+
+        // both factors carry n-1 fraction limbs, drop n-1 of the product's
+        Fixed result(n);
+        for (int k = 0; k < n; k++)
+            result.limbs[k] = product[k + n - 1];
+        result.negative = a.negative != b.negative;
+        return result;
+    }
+
+private:
+    static int compare_magnitude(const Fixed& a, const Fixed& b) {
+        for (int k = a.size() - 1; k >= 0; k--) {
+            if (a.limbs[k] != b.limbs[k])
+                return a.limbs[k] < b.limbs[k] ? -1 : 1;
+        }
+        return 0;
+    }
+
+    static Fixed add_magnitude(const Fixed& a, const Fixed& b) {
+        Fixed result(a.size());
+        uint64_t carry = 0;
+        for (int k = 0; k < a.size(); k++) {
+            uint64_t cur = (uint64_t)a.limbs[k] + b.limbs[k] + carry;
+            result.limbs[k] = cur & 0xFFFFFFFF;
+            carry = cur >> 32;
+        }
+        return result;
+    }
+
+    // |a| - |b| for |a| >= |b|
+    static Fixed sub_magnitude(const Fixed& a, const Fixed& b) {
+        Fixed result(a.size());
+        int64_t borrow = 0;
+        for (int k = 0; k < a.size(); k++) {
+            int64_t cur = (int64_t)a.limbs[k] - b.limbs[k] - borrow;
+            borrow = cur < 0;
+            result.limbs[k] = cur + (borrow << 32);
+        }
+        return result;
+    }
+};
+
+#endif
@@ -1,12 +1,46 @@
 #include <iostream>
+#include <string>
 
 namespace helper {
+    /**
+     * Optional rendering settings, everything not given keeps its default
+    */
+    struct Options {
+        std::string schedule = "modulo"; // modulo | tiles | subdivision
+        int tile_size = 32;
+        std::string isa = "auto"; // auto | scalar | avx2 | avx512
+        std::string interior = "none"; // none | analytic | periodicity | all
+        std::string ppm = "p6"; // p6 binary | p3 ascii
+        bool stream = false; // render in bands straight to the file
+        std::string color = "thread"; // thread | iterations | smooth
+        int refine = 0; // continue the unresolved pixels up to this many iterations
+        int antialias = 0; // samples per boundary pixel, off if <= 1
+        bool antialias_full = false; // supersample every pixel instead, for comparison
+        std::string profile = ""; // per thread statistics as json to this file
+        bool symmetry = false; // copy the rows mirrored at the real axis
+        int progressive = 0; // coarsest stride of a progressive render, off if <= 1
+        std::string center_re = ""; // view center as decimal strings, default view if empty
+        std::string center_im = "0";
+        double scale = 3.0; // width of the view in the complex plane
+        std::string precision = "double"; // float | double | double-double | perturbation | auto
+        int band_height = 256;
+        int bands_in_flight = 4;
+        std::string keyframes = ""; // keyframe file of a zoom animation, single frame if empty
+        int frames = 100;
+        std::string frame_prefix = "frame_";
+        double reuse_tolerance = -1; // in pixels, >= 0 reuses the previous frame's data (approximate), off if negative
+    };
+
+    std::string usage() {
+        return "Usage: --num-threads <integer> --height <integer> --width <integer>  --max-iterations <integer> --print-level <integer> [--schedule modulo|tiles|subdivision] [--tile-size <integer>] [--isa auto|scalar|avx2|avx512] [--interior none|analytic|periodicity|all] [--ppm p6|p3] [--color thread|iterations|smooth] [--refine <integer>] [--profile <json file>] [--symmetry] [--progressive <stride>] [--antialias <samples> [--antialias-full]] [--center-re <decimal> --center-im <decimal> --scale <double>] [--precision float|double|double-double|perturbation|auto] [--perturbation] [--stream] [--band-height <integer>] [--bands-in-flight <integer>] [--keyframes <file> [--frames <integer>] [--frame-prefix <string>] [--reuse-tolerance <pixels, approximate>]]";
+    }
+
     /**
      * Parsing arguments
      * 
     */
     void parse_args(int argc, char **argv, int& num_threads, int& height, int& width, int& max_iterations, int& print_level) {
-        std::string usage("Usage: --num-threads <integer> --height <integer> --width <integer>  --max-iterations <integer> --print-level <integer> ");
+        std::string usage = helper::usage();
 
         for (int i = 1; i < argc; ++i) {
             if ( std::string(argv[i]).compare("--num-threads") == 0 ) {
@@ -25,4 +59,62 @@ namespace helper {
             }
         }
     };
+
+    /**
+     * Parsing the optional rendering settings
+     * 
+    */
+    void parse_options(int argc, char **argv, Options& options) {
+        for (int i = 1; i < argc; ++i) {
+            if ( std::string(argv[i]).compare("--schedule") == 0 ) {
+                options.schedule=argv[++i];
+            } else if ( std::string(argv[i]).compare("--tile-size") == 0 ) {
+                options.tile_size=std::stoi(argv[++i]);
+            } else if ( std::string(argv[i]).compare("--isa") == 0 ) {
+                options.isa=argv[++i];
+            } else if ( std::string(argv[i]).compare("--interior") == 0 ) {
+                options.interior=argv[++i];
+            } else if ( std::string(argv[i]).compare("--ppm") == 0 ) {
+                options.ppm=argv[++i];
+            } else if ( std::string(argv[i]).compare("--color") == 0 ) {
+                options.color=argv[++i];
+            } else if ( std::string(argv[i]).compare("--refine") == 0 ) {
+                options.refine=std::stoi(argv[++i]);
+            } else if ( std::string(argv[i]).compare("--antialias") == 0 ) {
+                options.antialias=std::stoi(argv[++i]);
+            } else if ( std::string(argv[i]).compare("--antialias-full") == 0 ) {
+                options.antialias_full=true;
+            } else if ( std::string(argv[i]).compare("--profile") == 0 ) {
+                options.profile=argv[++i];
+            } else if ( std::string(argv[i]).compare("--symmetry") == 0 ) {
+                options.symmetry=true;
+            } else if ( std::string(argv[i]).compare("--progressive") == 0 ) {
+                options.progressive=std::stoi(argv[++i]);
+            } else if ( std::string(argv[i]).compare("--center-re") == 0 ) {
+                options.center_re=argv[++i];
+            } else if ( std::string(argv[i]).compare("--center-im") == 0 ) {
+                options.center_im=argv[++i];
+            } else if ( std::string(argv[i]).compare("--scale") == 0 ) {
+                options.scale=std::stod(argv[++i]);
+            } else if ( std::string(argv[i]).compare("--perturbation") == 0 ) {
+                options.precision="perturbation";
+            } else if ( std::string(argv[i]).compare("--precision") == 0 ) {
+                options.precision=argv[++i];
+            } else if ( std::string(argv[i]).compare("--stream") == 0 ) {
+                options.stream=true;
+            } else if ( std::string(argv[i]).compare("--band-height") == 0 ) {
+                options.band_height=std::stoi(argv[++i]);
+            } else if ( std::string(argv[i]).compare("--bands-in-flight") == 0 ) {
+                options.bands_in_flight=std::stoi(argv[++i]);
+            } else if ( std::string(argv[i]).compare("--keyframes") == 0 ) {
+                options.keyframes=argv[++i];
+            } else if ( std::string(argv[i]).compare("--frames") == 0 ) {
+                options.frames=std::stoi(argv[++i]);
+            } else if ( std::string(argv[i]).compare("--frame-prefix") == 0 ) {
+                options.frame_prefix=argv[++i];
+            } else if ( std::string(argv[i]).compare("--reuse-tolerance") == 0 ) {
+                options.reuse_tolerance=std::stod(argv[++i]);
+            }
+        }
+    };
 }
\ No newline at end of file
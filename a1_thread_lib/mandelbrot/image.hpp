@@ -1,9 +1,26 @@
 #include <iostream>
 #include <vector>
 #include <fstream>
+#include <string>
+#include <thread>
+#include <stdexcept>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "pixel.hpp"
 
+#ifndef _IMAGE_
+#define _IMAGE_
+
+// the binary writer dumps the pixel buffer as it is
+static_assert(sizeof(Pixel) == 3, "Pixel has to be packed rgb");
+
+enum class PpmFormat {
+    Ascii,  // P3, human readable, slow - for debugging
+    Binary  // P6, raw rgb bytes
+};
+
 struct Image {
     // Pixel** data = nullptr;
     std::vector<Pixel> data;
@@ -12,7 +29,7 @@ struct Image {
     int width;
     
     Image (int height, int width, const Pixel& val = {0, 0, 0}) 
-        : height(height), width(width), data(height*width, val )
+        : height(height), width(width), data((size_t)height*width, val )
     { }
 
     ~Image() {
@@ -26,23 +43,100 @@ struct Image {
     }
 
     Pixel* operator[](unsigned int row) {
-        return &data[row*width];
+        return &data[(size_t)row*width];
+    }
+
+    void save_to_ppm(std::string filename, PpmFormat format = PpmFormat::Binary, int num_threads = 1) {
+        if (format == PpmFormat::Binary)
+            save_to_p6(filename);
+        else
+            save_to_p3(filename, num_threads);
     }
 
-    void save_to_ppm(std::string filename) {
-        std::ofstream ofs(filename, std::ofstream::out);
-        ofs << "P3" << std::endl;
-        ofs << width << " " << height << std::endl;
-        ofs << 255 << std::endl;
+    /**
+     * Binary ppm, the pixel buffer goes to disk without any formatting, it is
+     * contiguous already, so one write is all it takes.
+    */
+    void save_to_p6(std::string filename) {
+        std::string header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
 
-        for (int row = 0; row < height; row++)
-        {
-            for (int col = 0; col < width; col++)
-            {
-                ofs << " " << (unsigned int)this->operator[](row)[col][0] << " " << (unsigned int)this->operator[](row)[col][1] << " " << (unsigned int)this->operator[](row)[col][2] << "\n";
+        int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            throw std::runtime_error("Could not open " + filename);
+
+        bool ok = write_at(fd, header.data(), header.size(), 0) &&
+                  write_at(fd, data.data(), (size_t)width * height * sizeof(Pixel), header.size());
+
+        close(fd);
+        if (!ok)
+            throw std::runtime_error("Could not write " + filename);
+    }
+
+    // pwrite may write less than asked for, keep going until everything is out
+    static bool write_at(int fd, const void* buf, size_t count, size_t offset) {
+        const char* ptr = static_cast<const char*>(buf);
+        while (count > 0) {
+            ssize_t written = pwrite(fd, ptr, count, offset);
+            if (written <= 0)
+                return false;
+            ptr += written;
+            count -= written;
+            offset += written;
+        }
+        return true;
+    }
+
+    /**
+     * Ascii ppm, the formatting is the expensive part. Every thread encodes a
+     * band of rows into its own buffer; the bands vary in length, so they are
+     * written one after the other once all of them are done.
+    */
+    void save_to_p3(std::string filename, int num_threads = 1) {
+        num_threads = std::max(1, std::min(num_threads, height));
+        std::vector<std::string> bands(num_threads);
+
+        auto encode = [&](int i) {
+            int begin = (size_t)height * i / num_threads;
+            int end = (size_t)height * (i + 1) / num_threads;
+            std::string& out = bands[i];
+            out.reserve((size_t)(end - begin) * width * 13);
+            for (int row = begin; row < end; row++) {
+                for (int col = 0; col < width; col++) {
+                    const Pixel& p = this->operator[](row)[col];
+                    out += ' ';
+                    out += std::to_string(p.r);
+                    out += ' ';
+                    out += std::to_string(p.g);
+                    out += ' ';
+                    out += std::to_string(p.b);
+                    out += '\n';
+                }
             }
+        };
+
+        std::vector<std::thread> thrds;
+        for (int i = 1; i < num_threads; i++)
+            thrds.emplace_back(encode, i);
+        encode(0);
+        for (auto& t : thrds)
+            t.join();
+
+        std::string header = "P3\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+
+        int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            throw std::runtime_error("Could not open " + filename);
+
+        bool ok = write_at(fd, header.data(), header.size(), 0);
+        size_t offset = header.size();
+        for (const std::string& band : bands) {
+            ok = ok && write_at(fd, band.data(), band.size(), offset);
+            offset += band.size();
         }
-        ofs.close();
+
+        close(fd);
+        if (!ok)
+            throw std::runtime_error("Could not write " + filename);
     }
 
     std::string to_string() {
@@ -56,4 +150,6 @@ struct Image {
         }
         return ss.str();
     }
-};
\ No newline at end of file
+};
+
+#endif
\ No newline at end of file
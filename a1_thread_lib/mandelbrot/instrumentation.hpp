@@ -0,0 +1,91 @@
+#include <vector>
+#include <string>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+
+#ifndef _INSTRUMENTATION_
+#define _INSTRUMENTATION_
+
+/**
+ * Sums up the time between start() and stop()
+*/
+struct Stopwatch {
+    std::chrono::steady_clock::time_point begin;
+    double seconds = 0;
+
+    void start() {
+        begin = std::chrono::steady_clock::now();
+    }
+
+    void stop() {
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    }
+};
+
+/**
+ * What one thread did during a compute call
+ *
+ * busy is the time spent on pixels, wait the time spent fetching work from
+ * the scheduler (locking, stealing, waiting for pushed tiles) and idle the
+ * rest of the call's wall time, i.e. after the thread ran out of work.
+*/
+struct ThreadStats {
+    double busy = 0;
+    double wait = 0;
+    double idle = 0;
+    size_t tiles = 0;
+    size_t pixels = 0;
+    size_t iterations = 0;
+};
+
+/**
+ * Per thread statistics of the last compute call
+*/
+struct Profile {
+    std::string mode;
+    double wall = 0;
+    std::vector<ThreadStats> threads;
+
+    // slowest thread against the average, 1 is perfectly balanced
+    double imbalance() const {
+        double max_busy = 0, sum_busy = 0;
+        for (const auto& t : threads) {
+            max_busy = std::max(max_busy, t.busy);
+            sum_busy += t.busy;
+        }
+        return sum_busy > 0 ? max_busy * threads.size() / sum_busy : 1.0;
+    }
+
+    size_t iterations() const {
+        size_t sum = 0;
+        for (const auto& t : threads) sum += t.iterations;
+        return sum;
+    }
+
+    double iterations_per_second() const {
+        return wall > 0 ? iterations() / wall : 0.0;
+    }
+
+    std::string to_json() const {
+        std::ostringstream out;
+        out << "{\n"
+            << "  \"mode\": \"" << mode << "\",\n"
+            << "  \"threads\": " << threads.size() << ",\n"
+            << "  \"wall_seconds\": " << wall << ",\n"
+            << "  \"iterations\": " << iterations() << ",\n"
+            << "  \"iterations_per_second\": " << iterations_per_second() << ",\n"
+            << "  \"imbalance\": " << imbalance() << ",\n"
+            << "  \"per_thread\": [\n";
+        for (size_t i = 0; i < threads.size(); i++) {
+            const ThreadStats& t = threads[i];
+            out << "    {\"thread\": " << i << ", \"busy_seconds\": " << t.busy << ", \"wait_seconds\": " << t.wait
+                << ", \"idle_seconds\": " << t.idle << ", \"tiles\": " << t.tiles << ", \"pixels\": " << t.pixels
+                << ", \"iterations\": " << t.iterations << "}" << (i + 1 < threads.size() ? "," : "") << "\n";
+        }
+        out << "  ]\n}\n";
+        return out.str();
+    }
+};
+
+#endif
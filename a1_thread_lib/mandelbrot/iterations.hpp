@@ -0,0 +1,43 @@
+#include <vector>
+#include <cstdint>
+#include <stdexcept>
+
+#ifndef _ITERATIONS_
+#define _ITERATIONS_
+
+/**
+ * Raw escape data of a frame
+ *
+ * counts holds the escape iteration of every pixel (max_iterations for the
+ * ones inside of the set), smooth the fractional escape count if requested.
+ * Colors are derived from it in a separate pass, see palette.hpp.
+*/
+struct IterationBuffer {
+    int height = 0;
+    int width = 0;
+    int max_iterations = 0;
+
+    std::vector<uint16_t> counts;
+    std::vector<float> smooth;
+
+    IterationBuffer() { }
+
+    IterationBuffer(int height, int width, int max_iterations, bool with_smooth = false)
+        : height(height), width(width), max_iterations(max_iterations), counts((size_t)height * width, 0)
+    {
+        if (max_iterations > UINT16_MAX)
+            throw std::invalid_argument("Iteration buffer holds at most 65535 iterations");
+        if (with_smooth)
+            smooth.assign((size_t)height * width, 0.0f);
+    }
+
+    bool has_smooth() const {
+        return !smooth.empty();
+    }
+
+    uint16_t* operator[](unsigned int row) {
+        return &counts[(size_t)row * width];
+    }
+};
+
+#endif
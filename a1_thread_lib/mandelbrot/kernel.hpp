@@ -0,0 +1,527 @@
+#include <string>
+#include <type_traits>
+#include <algorithm>
+
+#include "double_double.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KERNEL_X86 1
+#endif
+
+#ifndef _KERNEL_
+#define _KERNEL_
+
+/**
+ * Escape-time kernels
+ *
+ * All kernels compute the same thing: for every c = (cr[i], ci[i]) iterate
+ * z = z*z + c starting at z = 0 and store in iters[i] the iteration in which
+ * |z| > 4 first held (squared magnitude bailout, no sqrt), or max_iterations
+ * for points that never escaped (inside of the set).
+ *
+ * With periodicity checking enabled, the orbit is compared against a value
+ * saved at every power of two iteration (Brent-style). An orbit that comes
+ * back within `cycle_tolerance` of it is caught in a cycle and will never
+ * escape, so the point is reported as inside right away. The batch kernels
+ * return how many of their points were resolved that way and how many of the
+ * max_iterations those points were spared.
+ *
+ * If mags is given, it receives |z|^2 at the moment of escape (for smooth
+ * coloring), points that did not escape get 0.
+ *
+ * If an orbit is given, the points continue from the z stored in it after
+ * orbit->iteration iterations instead of starting at z = 0, and the z where
+ * they stopped is written back, so a later call can raise max_iterations
+ * without redoing the work.
+ *
+ * The scalar kernel is a template over the number type (float, double or
+ * DoubleDouble); the SIMD kernels exist for float and double. Orbits can only
+ * be saved for double.
+ *
+ * The SIMD versions are compiled with target attributes, so the file builds
+ * with a plain g++ invocation and the widest ISA is picked at runtime.
+*/
+namespace kernel {
+
+    enum class Isa { Scalar, AVX2, AVX512 };
+
+    // pixels handed to a kernel at once, a multiple of every vector width
+    constexpr int batch = 64;
+
+    // squared distance under which two orbit points count as the same
+    constexpr double cycle_tolerance = 1e-24;
+
+    // main cardioid: q * (q + (x - 1/4)) <= y^2 / 4 with q = (x - 1/4)^2 + y^2
+    inline bool in_main_cardioid(double cr, double ci) {
+        double xr = cr - 0.25;
+        double q = xr * xr + ci * ci;
+        return q * (q + xr) <= 0.25 * ci * ci;
+    }
+
+    // period-2 bulb: disc of radius 1/4 around -1
+    inline bool in_period2_bulb(double cr, double ci) {
+        double xr = cr + 1.0;
+        return xr * xr + ci * ci <= 0.0625;
+    }
+
+    // number type of the iteration, see choose_precision
+    enum class Precision { Float, Double, DoubleDouble, Perturbation, Auto };
+
+    /**
+     * Cheapest precision that still resolves the pixel spacing: the spacing
+     * has to stay well above the rounding error of the type around the view,
+     * where |z| is of the order of max(|center|, 1).
+    */
+    inline Precision choose_precision(double spacing, double center_magnitude) {
+        double relative = spacing / std::max(center_magnitude, 1.0);
+        if (relative >= 0x1p-16) return Precision::Float;
+        if (relative >= 0x1p-45) return Precision::Double;
+        if (relative >= 0x1p-95) return Precision::DoubleDouble;
+        return Precision::Perturbation;
+    }
+
+    inline Precision parse_precision(const std::string& name) {
+        if (name == "float") return Precision::Float;
+        if (name == "double-double") return Precision::DoubleDouble;
+        if (name == "perturbation") return Precision::Perturbation;
+        if (name == "auto") return Precision::Auto;
+        return Precision::Double;
+    }
+
+    inline std::string precision_name(Precision precision) {
+        switch (precision) {
+            case Precision::Float: return "float";
+            case Precision::DoubleDouble: return "double-double";
+            case Precision::Perturbation: return "perturbation";
+            case Precision::Auto: return "auto";
+            default: return "double";
+        }
+    }
+
+    // saved orbits of a batch of points, see above
+    struct Orbit {
+        double* zr;
+        double* zi;
+        int iteration;
+    };
+
+    // points of a batch caught in a cycle and the iterations they did not run
+    struct Cycles {
+        int points = 0;
+        size_t skipped = 0;
+
+        Cycles& operator+=(const Cycles& other) {
+            points += other.points;
+            skipped += other.skipped;
+            return *this;
+        }
+    };
+
+    // max_iterations - count over the lanes set in mask
+    template<typename T>
+    inline size_t skipped_iterations(const T* counts, unsigned mask, int max_iterations) {
+        size_t skipped = 0;
+        for (; mask; mask &= mask - 1)
+            skipped += max_iterations - (int)counts[__builtin_ctz(mask)];
+        return skipped;
+    }
+
+    template<typename T>
+    inline int escape_one(T cr, T ci, T& zr, T& zi, int first_iteration, int max_iterations, bool periodicity, int& cycle_at, double& mag) {
+        T sr = zr, si = zi;
+        cycle_at = -1;
+        mag = 0;
+
+        for (int i = first_iteration; i < max_iterations; ++i) {
+            T zr2 = zr * zr;
+            T zi2 = zi * zi;
+            zi = zr * zi + zr * zi + ci;
+            zr = zr2 - zi2 + cr;
+            double zmag = to_double(zr * zr + zi * zi);
+            if (zmag > 16.0) {
+                mag = zmag;
+                return i;
+            }
+
+            if (periodicity) {
+                if ((i & (i + 1)) == 0) {
+                    sr = zr;
+                    si = zi;
+                } else if (to_double((zr - sr) * (zr - sr) + (zi - si) * (zi - si)) < cycle_tolerance) {
+                    cycle_at = i;
+                    return max_iterations;
+                }
+            }
+        }
+        return max_iterations;
+    }
+
+    inline int escape_one(double cr, double ci, int max_iterations) {
+        int cycle_at;
+        double mag, zr = 0, zi = 0;
+        return escape_one(cr, ci, zr, zi, 0, max_iterations, false, cycle_at, mag);
+    }
+
+    template<typename T>
+    inline Cycles escape_scalar(const T* cr, const T* ci, int n, int* iters, int max_iterations, bool periodicity, double* mags = nullptr, const Orbit* orbit = nullptr) {
+        Cycles cycles;
+        for (int i = 0; i < n; i++) {
+            int cycle_at;
+            double mag;
+            T zr = 0, zi = 0;
+            if (orbit) {
+                zr = orbit->zr[i];
+                zi = orbit->zi[i];
+            }
+            iters[i] = escape_one<T>(cr[i], ci[i], zr, zi, orbit ? orbit->iteration : 0, max_iterations, periodicity, cycle_at, mag);
+            if (orbit) {
+                orbit->zr[i] = to_double(zr);
+                orbit->zi[i] = to_double(zi);
+            }
+            if (cycle_at >= 0) {
+                cycles.points++;
+                cycles.skipped += max_iterations - cycle_at;
+            }
+            if (mags) mags[i] = mag;
+        }
+        return cycles;
+    }
+
+    // the points of a batch left over after the last full vector
+    template<typename T>
+    inline Cycles escape_tail(const T* cr, const T* ci, int i, int n, int* iters, int max_iterations, bool periodicity, double* mags, const Orbit* orbit) {
+        Orbit rest{};
+        if (orbit) rest = {orbit->zr + i, orbit->zi + i, orbit->iteration};
+        return escape_scalar(cr + i, ci + i, n - i, iters + i, max_iterations, periodicity,
+                             mags ? mags + i : nullptr, orbit ? &rest : nullptr);
+    }
+
+#ifdef KERNEL_X86
+    __attribute__((target("avx2")))
+    inline Cycles escape_avx2(const double* cr, const double* ci, int n, int* iters, int max_iterations, bool periodicity, double* mags = nullptr, const Orbit* orbit = nullptr) {
+        const __m256d bailout = _mm256_set1_pd(16.0);
+        const __m256d one = _mm256_set1_pd(1.0);
+        const __m256d tolerance = _mm256_set1_pd(cycle_tolerance);
+        const __m256d max_count = _mm256_set1_pd(max_iterations);
+        const int first_iteration = orbit ? orbit->iteration : 0;
+        Cycles cycles;
+
+        int i = 0;
+        for (; i + 4 <= n; i += 4) {
+            __m256d vcr = _mm256_loadu_pd(cr + i);
+            __m256d vci = _mm256_loadu_pd(ci + i);
+            __m256d zr = orbit ? _mm256_loadu_pd(orbit->zr + i) : _mm256_setzero_pd();
+            __m256d zi = orbit ? _mm256_loadu_pd(orbit->zi + i) : _mm256_setzero_pd();
+            __m256d count = _mm256_set1_pd(first_iteration);
+            // all bits set in a lane while the lane has not escaped yet
+            __m256d active = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+            __m256d sr = zr, si = zi;
+            __m256d escape_mag = _mm256_setzero_pd();
+
+            for (int it = first_iteration; it < max_iterations; ++it) {
+                __m256d zr2 = _mm256_mul_pd(zr, zr);
+                __m256d zi2 = _mm256_mul_pd(zi, zi);
+                __m256d zri = _mm256_mul_pd(zr, zi);
+                zi = _mm256_add_pd(_mm256_add_pd(zri, zri), vci);
+                zr = _mm256_add_pd(_mm256_sub_pd(zr2, zi2), vcr);
+
+                __m256d mag = _mm256_add_pd(_mm256_mul_pd(zr, zr), _mm256_mul_pd(zi, zi));
+                __m256d escaped = _mm256_and_pd(_mm256_cmp_pd(mag, bailout, _CMP_GT_OQ), active);
+                escape_mag = _mm256_blendv_pd(escape_mag, mag, escaped);
+                active = _mm256_andnot_pd(escaped, active);
+
+                if (periodicity) {
+                    if ((it & (it + 1)) == 0) {
+                        sr = zr;
+                        si = zi;
+                    } else {
+                        __m256d dr = _mm256_sub_pd(zr, sr);
+                        __m256d di = _mm256_sub_pd(zi, si);
+                        __m256d dist = _mm256_add_pd(_mm256_mul_pd(dr, dr), _mm256_mul_pd(di, di));
+                        __m256d cycle = _mm256_and_pd(_mm256_cmp_pd(dist, tolerance, _CMP_LT_OQ), active);
+                        int mask = _mm256_movemask_pd(cycle);
+                        if (mask) {
+                            double lanes[4];
+                            _mm256_storeu_pd(lanes, count);
+                            cycles.points += __builtin_popcount(mask);
+                            cycles.skipped += skipped_iterations(lanes, mask, max_iterations);
+                            count = _mm256_blendv_pd(count, max_count, cycle);
+                            active = _mm256_andnot_pd(cycle, active);
+                        }
+                    }
+                }
+
+                if (_mm256_movemask_pd(active) == 0) break;
+
+                count = _mm256_add_pd(count, _mm256_and_pd(active, one));
+            }
+
+            _mm_storeu_si128((__m128i*)(iters + i), _mm256_cvtpd_epi32(count));
+            if (mags) _mm256_storeu_pd(mags + i, escape_mag);
+            if (orbit) {
+                _mm256_storeu_pd(orbit->zr + i, zr);
+                _mm256_storeu_pd(orbit->zi + i, zi);
+            }
+        }
+
+        cycles += escape_tail(cr, ci, i, n, iters, max_iterations, periodicity, mags, orbit);
+        return cycles;
+    }
+
+    // avx512f implies fma, keep gcc from contracting mul+add so all kernels agree bit for bit
+    __attribute__((target("avx512f"), optimize("fp-contract=off")))
+    inline Cycles escape_avx512(const double* cr, const double* ci, int n, int* iters, int max_iterations, bool periodicity, double* mags = nullptr, const Orbit* orbit = nullptr) {
+        const __m512d bailout = _mm512_set1_pd(16.0);
+        const __m512d one = _mm512_set1_pd(1.0);
+        const __m512d tolerance = _mm512_set1_pd(cycle_tolerance);
+        const __m512d max_count = _mm512_set1_pd(max_iterations);
+        const int first_iteration = orbit ? orbit->iteration : 0;
+        Cycles cycles;
+
+        int i = 0;
+        for (; i + 8 <= n; i += 8) {
+            __m512d vcr = _mm512_loadu_pd(cr + i);
+            __m512d vci = _mm512_loadu_pd(ci + i);
+            __m512d zr = orbit ? _mm512_loadu_pd(orbit->zr + i) : _mm512_setzero_pd();
+            __m512d zi = orbit ? _mm512_loadu_pd(orbit->zi + i) : _mm512_setzero_pd();
+            __m512d count = _mm512_set1_pd(first_iteration);
+            __mmask8 active = 0xFF;
+            __m512d sr = zr, si = zi;
+            __m512d escape_mag = _mm512_setzero_pd();
+
+            for (int it = first_iteration; it < max_iterations; ++it) {
+                __m512d zr2 = _mm512_mul_pd(zr, zr);
+                __m512d zi2 = _mm512_mul_pd(zi, zi);
+                __m512d zri = _mm512_mul_pd(zr, zi);
+                zi = _mm512_add_pd(_mm512_add_pd(zri, zri), vci);
+                zr = _mm512_add_pd(_mm512_sub_pd(zr2, zi2), vcr);
+
+                __m512d mag = _mm512_add_pd(_mm512_mul_pd(zr, zr), _mm512_mul_pd(zi, zi));
+                __mmask8 escaped = _mm512_mask_cmp_pd_mask(active, mag, bailout, _CMP_GT_OQ);
+                escape_mag = _mm512_mask_mov_pd(escape_mag, escaped, mag);
+                active &= ~escaped;
+
+                if (periodicity) {
+                    if ((it & (it + 1)) == 0) {
+                        sr = zr;
+                        si = zi;
+                    } else {
+                        __m512d dr = _mm512_sub_pd(zr, sr);
+                        __m512d di = _mm512_sub_pd(zi, si);
+                        __m512d dist = _mm512_add_pd(_mm512_mul_pd(dr, dr), _mm512_mul_pd(di, di));
+                        __mmask8 cycle = _mm512_mask_cmp_pd_mask(active, dist, tolerance, _CMP_LT_OQ);
+                        if (cycle) {
+                            double lanes[8];
+                            _mm512_storeu_pd(lanes, count);
+                            cycles.points += __builtin_popcount(cycle);
+                            cycles.skipped += skipped_iterations(lanes, cycle, max_iterations);
+                            count = _mm512_mask_mov_pd(count, cycle, max_count);
+                            active &= ~cycle;
+                        }
+                    }
+                }
+
+                if (active == 0) break;
+
+                count = _mm512_mask_add_pd(count, active, count, one);
+            }
+
+            // the zero masked form, the plain one converts from an undefined register GCC warns about
+            _mm256_storeu_si256((__m256i*)(iters + i), _mm512_maskz_cvtpd_epi32(0xFF, count));
+            if (mags) _mm512_storeu_pd(mags + i, escape_mag);
+            if (orbit) {
+                _mm512_storeu_pd(orbit->zr + i, zr);
+                _mm512_storeu_pd(orbit->zi + i, zi);
+            }
+        }
+
+        cycles += escape_tail(cr, ci, i, n, iters, max_iterations, periodicity, mags, orbit);
+        return cycles;
+    }
+
+    // same as the double kernels with twice the lanes
+    __attribute__((target("avx2")))
+    inline Cycles escape_avx2(const float* cr, const float* ci, int n, int* iters, int max_iterations, bool periodicity, double* mags = nullptr) {
+        const __m256 bailout = _mm256_set1_ps(16.0f);
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 tolerance = _mm256_set1_ps(cycle_tolerance);
+        const __m256 max_count = _mm256_set1_ps(max_iterations);
+        Cycles cycles;
+
+        int i = 0;
+        for (; i + 8 <= n; i += 8) {
+            __m256 vcr = _mm256_loadu_ps(cr + i);
+            __m256 vci = _mm256_loadu_ps(ci + i);
+            __m256 zr = _mm256_setzero_ps();
+            __m256 zi = _mm256_setzero_ps();
+            __m256 count = _mm256_setzero_ps();
+            __m256 active = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            __m256 sr = zr, si = zi;
+            __m256 escape_mag = _mm256_setzero_ps();
+
+            for (int it = 0; it < max_iterations; ++it) {
+                __m256 zr2 = _mm256_mul_ps(zr, zr);
+                __m256 zi2 = _mm256_mul_ps(zi, zi);
+                __m256 zri = _mm256_mul_ps(zr, zi);
+                zi = _mm256_add_ps(_mm256_add_ps(zri, zri), vci);
+                zr = _mm256_add_ps(_mm256_sub_ps(zr2, zi2), vcr);
+
+                __m256 mag = _mm256_add_ps(_mm256_mul_ps(zr, zr), _mm256_mul_ps(zi, zi));
+                __m256 escaped = _mm256_and_ps(_mm256_cmp_ps(mag, bailout, _CMP_GT_OQ), active);
+                escape_mag = _mm256_blendv_ps(escape_mag, mag, escaped);
+                active = _mm256_andnot_ps(escaped, active);
+
+                if (periodicity) {
+                    if ((it & (it + 1)) == 0) {
+                        sr = zr;
+                        si = zi;
+                    } else {
+                        __m256 dr = _mm256_sub_ps(zr, sr);
+                        __m256 di = _mm256_sub_ps(zi, si);
+                        __m256 dist = _mm256_add_ps(_mm256_mul_ps(dr, dr), _mm256_mul_ps(di, di));
+                        __m256 cycle = _mm256_and_ps(_mm256_cmp_ps(dist, tolerance, _CMP_LT_OQ), active);
+                        int mask = _mm256_movemask_ps(cycle);
+                        if (mask) {
+                            float lanes[8];
+                            _mm256_storeu_ps(lanes, count);
+                            cycles.points += __builtin_popcount(mask);
+                            cycles.skipped += skipped_iterations(lanes, mask, max_iterations);
+                            count = _mm256_blendv_ps(count, max_count, cycle);
+                            active = _mm256_andnot_ps(cycle, active);
+                        }
+                    }
+                }
+
+                if (_mm256_movemask_ps(active) == 0) break;
+
+                count = _mm256_add_ps(count, _mm256_and_ps(active, one));
+            }
+
+            _mm256_storeu_si256((__m256i*)(iters + i), _mm256_cvtps_epi32(count));
+            if (mags) {
+                float lane_mags[8];
+                _mm256_storeu_ps(lane_mags, escape_mag);
+                for (int l = 0; l < 8; l++) mags[i + l] = lane_mags[l];
+            }
+        }
+
+        cycles += escape_tail(cr, ci, i, n, iters, max_iterations, periodicity, mags, nullptr);
+        return cycles;
+    }
+
+    __attribute__((target("avx512f"), optimize("fp-contract=off")))
+    inline Cycles escape_avx512(const float* cr, const float* ci, int n, int* iters, int max_iterations, bool periodicity, double* mags = nullptr) {
+        const __m512 bailout = _mm512_set1_ps(16.0f);
+        const __m512 one = _mm512_set1_ps(1.0f);
+        const __m512 tolerance = _mm512_set1_ps(cycle_tolerance);
+        const __m512 max_count = _mm512_set1_ps(max_iterations);
+        Cycles cycles;
+
+        int i = 0;
+        for (; i + 16 <= n; i += 16) {
+            __m512 vcr = _mm512_loadu_ps(cr + i);
+            __m512 vci = _mm512_loadu_ps(ci + i);
+            __m512 zr = _mm512_setzero_ps();
+            __m512 zi = _mm512_setzero_ps();
+            __m512 count = _mm512_setzero_ps();
+            __mmask16 active = 0xFFFF;
+            __m512 sr = zr, si = zi;
+            __m512 escape_mag = _mm512_setzero_ps();
+
+            for (int it = 0; it < max_iterations; ++it) {
+                __m512 zr2 = _mm512_mul_ps(zr, zr);
+                __m512 zi2 = _mm512_mul_ps(zi, zi);
+                __m512 zri = _mm512_mul_ps(zr, zi);
+                zi = _mm512_add_ps(_mm512_add_ps(zri, zri), vci);
+                zr = _mm512_add_ps(_mm512_sub_ps(zr2, zi2), vcr);
+
+                __m512 mag = _mm512_add_ps(_mm512_mul_ps(zr, zr), _mm512_mul_ps(zi, zi));
+                __mmask16 escaped = _mm512_mask_cmp_ps_mask(active, mag, bailout, _CMP_GT_OQ);
+                escape_mag = _mm512_mask_mov_ps(escape_mag, escaped, mag);
+                active &= ~escaped;
+
+                if (periodicity) {
+                    if ((it & (it + 1)) == 0) {
+                        sr = zr;
+                        si = zi;
+                    } else {
+                        __m512 dr = _mm512_sub_ps(zr, sr);
+                        __m512 di = _mm512_sub_ps(zi, si);
+                        __m512 dist = _mm512_add_ps(_mm512_mul_ps(dr, dr), _mm512_mul_ps(di, di));
+                        __mmask16 cycle = _mm512_mask_cmp_ps_mask(active, dist, tolerance, _CMP_LT_OQ);
+                        if (cycle) {
+                            float lanes[16];
+                            _mm512_storeu_ps(lanes, count);
+                            cycles.points += __builtin_popcount(cycle);
+                            cycles.skipped += skipped_iterations(lanes, cycle, max_iterations);
+                            count = _mm512_mask_mov_ps(count, cycle, max_count);
+                            active &= ~cycle;
+                        }
+                    }
+                }
+
+                if (active == 0) break;
+
+                count = _mm512_mask_add_ps(count, active, count, one);
+            }
+
+            _mm512_storeu_si512((void*)(iters + i), _mm512_maskz_cvtps_epi32(0xFFFF, count));
+            if (mags) {
+                float lane_mags[16];
+                _mm512_storeu_ps(lane_mags, escape_mag);
+                for (int l = 0; l < 16; l++) mags[i + l] = lane_mags[l];
+            }
+        }
+
+        cycles += escape_tail(cr, ci, i, n, iters, max_iterations, periodicity, mags, nullptr);
+        return cycles;
+    }
+#endif
+
+    // widest instruction set supported by the cpu we are running on
+    inline Isa detect() {
+#ifdef KERNEL_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) return Isa::AVX512;
+        if (__builtin_cpu_supports("avx2")) return Isa::AVX2;
+#endif
+        return Isa::Scalar;
+    }
+
+    // never hands out an instruction set the cpu can not execute
+    inline Isa clamp(Isa wanted) {
+        Isa best = detect();
+        return (int)wanted < (int)best ? wanted : best;
+    }
+
+    inline Isa parse_isa(const std::string& name) {
+        if (name == "scalar") return Isa::Scalar;
+        if (name == "avx2") return Isa::AVX2;
+        return detect();
+    }
+
+    inline Cycles escape(Isa isa, const double* cr, const double* ci, int n, int* iters, int max_iterations, bool periodicity = false, double* mags = nullptr, const Orbit* orbit = nullptr) {
+#ifdef KERNEL_X86
+        if (isa == Isa::AVX512) return escape_avx512(cr, ci, n, iters, max_iterations, periodicity, mags, orbit);
+        if (isa == Isa::AVX2) return escape_avx2(cr, ci, n, iters, max_iterations, periodicity, mags, orbit);
+#endif
+        return escape_scalar(cr, ci, n, iters, max_iterations, periodicity, mags, orbit);
+    }
+
+    // float has twice the lanes of double, but no saved orbits
+    inline Cycles escape(Isa isa, const float* cr, const float* ci, int n, int* iters, int max_iterations, bool periodicity = false, double* mags = nullptr) {
+#ifdef KERNEL_X86
+        if (isa == Isa::AVX512) return escape_avx512(cr, ci, n, iters, max_iterations, periodicity, mags);
+        if (isa == Isa::AVX2) return escape_avx2(cr, ci, n, iters, max_iterations, periodicity, mags);
+#endif
+        return escape_scalar(cr, ci, n, iters, max_iterations, periodicity, mags);
+    }
+
+    // no vector registers wide enough for double-double, scalar only
+    inline Cycles escape(Isa, const DoubleDouble* cr, const DoubleDouble* ci, int n, int* iters, int max_iterations, bool periodicity = false, double* mags = nullptr) {
+        return escape_scalar(cr, ci, n, iters, max_iterations, periodicity, mags);
+    }
+}
+
+#endif
@@ -13,6 +13,7 @@
 
 #include "helper.hpp"
 #include "mandelbrot.hpp"
+#include "animation.hpp"
 
 using namespace std;
 
@@ -26,27 +27,139 @@ int main(int argc, char **argv)
     // height and width of the output image
     int width = 512, height = 384;
 
+    helper::Options options;
+
     helper::parse_args(argc, argv, num_threads, height, width, max_iterations, print_level);
+    helper::parse_options(argc, argv, options);
 
     std::cout << "Generating Mandelbrot for " << width << "x" << height << " image (max iterations: " << max_iterations << ") with " << num_threads << " threads.\n";
     
-    int pixels_inside = 0;
+    size_t pixels_inside = 0;
+
+    // Generate Mandelbrot set in this image, in streaming mode only a few
+    // bands of it are kept in memory
+    Mandelbrot mb(height, width, max_iterations, options.stream); 
 
-    // Generate Mandelbrot set in this image
-    Mandelbrot mb(height, width, max_iterations); 
+    if (options.schedule == "tiles")
+        mb.set_schedule(Schedule::Tiles, options.tile_size);
+    else if (options.schedule == "subdivision")
+        mb.set_schedule(Schedule::Subdivision);
+
+    mb.set_isa(kernel::parse_isa(options.isa));
+    mb.set_symmetry(options.symmetry);
+    mb.set_profiling(!options.profile.empty());
+    mb.set_interior_checks(options.interior == "analytic" || options.interior == "all",
+                           options.interior == "periodicity" || options.interior == "all");
     
     std::vector<std::thread> threads;
 
     auto t1 = chrono::high_resolution_clock::now();
 
-    pixels_inside = mb.compute(num_threads);
+    if (!options.center_re.empty())
+        mb.set_view(options.center_re, options.center_im, options.scale);
+    mb.set_precision(kernel::parse_precision(options.precision));
+    if (mb.get_precision() == kernel::Precision::Perturbation && options.color == "thread" && !options.stream)
+        options.color = "smooth";
+
+    // zoom animation: the frames are colored from their escape data
+    if (!options.keyframes.empty()) {
+        std::vector<animation::Keyframe> keyframes = animation::load_keyframes(options.keyframes);
+
+        animation::Stats stats = animation::render(mb, keyframes, options.frames, height, width, max_iterations,
+                                                   options.color == "smooth", options.frame_prefix, num_threads,
+                                                   options.reuse_tolerance);
+        auto t2 = chrono::high_resolution_clock::now();
+
+        cout << "Total Mandelbrot pixels: " << stats.pixels_inside << " in " << stats.frames << " frames" << endl;
+        if ( print_level >= 1 ) cout << "Reused pixels: " << stats.reused_pixels << ", compute time: " << stats.compute_time << endl;
+        if ( print_level >= 1 ) cout << chrono::duration<double>(t2 - t1).count() << endl;
+        return 0;
+    }
+
+    // the streaming mode hands out rows on its own and keeps no per thread statistics
+    if (options.stream && (options.schedule != "modulo" || !options.profile.empty())) {
+        cerr << "--stream can not be combined with --schedule or --profile" << endl;
+        cout << helper::usage() << endl;
+        exit(-1);
+    }
+
+    // the streaming mode writes thread colors band by band and keeps no escape data
+    if (options.stream && (options.color != "thread" || options.refine > max_iterations || options.progressive > 1 ||
+                           options.antialias > 1 || options.symmetry)) {
+        cerr << "--stream writes thread colors only, it can not be combined with --color iterations|smooth, --refine, --progressive, --antialias or --symmetry" << endl;
+        exit(-1);
+    }
+
+    // refining needs the escape data, the thread colors can not be continued
+    if (options.refine > max_iterations) {
+        mb.set_resumable(true);
+        if (options.color == "thread") options.color = "iterations";
+    }
+
+    // the preview levels, the anti-aliasing and the mirroring work on escape data as well
+    if ((options.progressive > 1 || options.antialias > 1 || options.symmetry) && options.color == "thread")
+        options.color = "iterations";
+
+    // escape data for the palette based coloring
+    IterationBuffer iterations;
+    if (options.color == "smooth" && !options.stream)
+        iterations = IterationBuffer(height, width, max_iterations, true);
+
+    if (options.stream)
+        pixels_inside = mb.compute_streaming("mandelbrot.ppm", num_threads, options.band_height, options.bands_in_flight);
+    else if (options.progressive > 1)
+        pixels_inside = mb.compute_progressive(iterations, num_threads, [&](const IterationBuffer&, int stride) {
+            auto t = chrono::high_resolution_clock::now();
+            if ( print_level >= 1 ) cout << "Stride " << stride << " ready after " << chrono::duration<double>(t - t1).count() << endl;
+        }, options.progressive);
+    else if (options.color != "thread")
+        pixels_inside = mb.compute_iterations(iterations, num_threads);
+    else
+        pixels_inside = mb.compute(num_threads);
 
     auto t2 = chrono::high_resolution_clock::now();
 
-    // save image
-    mb.save_to_ppm("mandelbrot.ppm");
+    if (!options.stream && options.refine > max_iterations) {
+        if ( print_level >= 1 ) cout << "Total Mandelbrot pixels at " << max_iterations << " iterations: " << pixels_inside << endl;
+
+        auto t3 = chrono::high_resolution_clock::now();
+        mb.set_max_iterations(options.refine);
+        pixels_inside = mb.compute_iterations(iterations, num_threads);
+        auto t4 = chrono::high_resolution_clock::now();
+        if ( print_level >= 1 ) cout << "Refine to " << options.refine << " iterations time: " << chrono::duration<double>(t4 - t3).count() << endl;
+    }
+
+    if (!options.stream && options.color != "thread") {
+        auto t3 = chrono::high_resolution_clock::now();
+        mb.colorize(iterations, Palette::gradient(), num_threads);
+        auto t4 = chrono::high_resolution_clock::now();
+        if ( print_level >= 1 ) cout << "Colorize time: " << chrono::duration<double>(t4 - t3).count() << endl;
+    }
+
+    if (!options.stream && options.antialias > 1) {
+        auto t3 = chrono::high_resolution_clock::now();
+        size_t supersampled = mb.antialias(iterations, Palette::gradient(), options.antialias, num_threads, options.antialias_full);
+        auto t4 = chrono::high_resolution_clock::now();
+        if ( print_level >= 1 ) cout << "Supersampled pixels: " << supersampled << ", time: " << chrono::duration<double>(t4 - t3).count() << endl;
+    }
+
+    // save image, the streaming mode has already written it
+    if (!options.stream)
+        mb.save_to_ppm("mandelbrot.ppm", options.ppm == "p3" ? PpmFormat::Ascii : PpmFormat::Binary, num_threads);
 
     cout << "Total Mandelbrot pixels: " << pixels_inside << endl;
+    if ( print_level >= 1 && options.interior != "none" ) {
+        InteriorStats stats = mb.get_interior_stats();
+        cout << "Resolved by cardioid: " << stats.cardioid << ", bulb: " << stats.bulb << ", periodicity: " << stats.periodic << endl;
+    }
+    if (!options.profile.empty()) {
+        const Profile& profile = mb.get_profile();
+        ofstream(options.profile) << profile.to_json();
+        if ( print_level >= 1 ) cout << "Imbalance: " << profile.imbalance() << ", iterations/s: " << profile.iterations_per_second() << endl;
+    }
+    if ( print_level >= 1 && options.symmetry ) cout << "Mirrored pixels: " << mb.get_mirrored_pixels() << endl;
+    if ( print_level >= 1 && options.precision != "double" ) cout << "Precision: " << kernel::precision_name(mb.get_precision()) << endl;
+    if ( print_level >= 1 && mb.get_precision() == kernel::Precision::Perturbation ) cout << "Perturbation rebases: " << mb.get_rebases() << endl;
     if ( print_level >= 1 ) cout << chrono::duration<double>(t2 - t1).count() << endl;
 
     return 0;
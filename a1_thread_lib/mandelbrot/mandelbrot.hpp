@@ -1,24 +1,290 @@
 
 #include <vector>
 #include <complex>
+#include <cmath>
 #include <numeric>
 #include <mutex>
 #include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <algorithm>
+#include <random>
 #include "pixel.hpp"
 #include "image.hpp"
+#include "tile_scheduler.hpp"
+#include "kernel.hpp"
+#include "iterations.hpp"
+#include "palette.hpp"
+#include "perturbation.hpp"
+#include "worker_pool.hpp"
+#include "instrumentation.hpp"
+
+#ifndef _MANDELBROT_
+#define _MANDELBROT_
+
+// how the pixels of the image are distributed among the threads
+enum class Schedule {
+    Modulo, // pixel (x, y) goes to thread (y * width + x) % num_threads
+    Tiles,  // rectangular tiles from per-thread deques with work stealing
+    Subdivision // Mariani-Silver: rectangles with a uniform border are filled
+};
+
+// how many pixels inside of the set each interior shortcut resolved
+struct InteriorStats {
+    size_t cardioid = 0;
+    size_t bulb = 0;
+    size_t periodic = 0;
+    size_t iterations = 0; // run by the kernels, a periodic orbit up to where its cycle was caught
+
+    InteriorStats& operator+=(const InteriorStats& other) {
+        cardioid += other.cardioid;
+        bulb += other.bulb;
+        periodic += other.periodic;
+        iterations += other.iterations;
+        return *this;
+    }
+};
+
+/**
+ * Part of the complex plane shown by the image, pixel (x, y) maps to
+ * (center_re + (x / width - 0.5) * span_re, center_im + (y / height - 0.5) * span_im)
+*/
+struct Viewport {
+    double center_re = -0.5;
+    double center_im = 0.0;
+    double span_re = 2.0;
+    double span_im = 2.0;
+};
 
 class Mandelbrot {
     Image image;
 
+    // size of the whole frame, in streaming mode image only holds a band of it
+    int width;
+    int height;
+
     int max_iterations = 2048;
     int pixels_inside = 0;
     std::mutex mutex;
-    
+
+    Schedule schedule = Schedule::Modulo;
+    int tile_size = 32;
+
+    kernel::Isa isa = kernel::detect();
+
+    // interior shortcuts, see set_interior_checks
+    bool analytic_checks = false;
+    bool periodicity_checks = false;
+    InteriorStats interior_stats;
+
+    // escape counts of the subdivision renderer, -1 while not computed yet
+    std::vector<int> subdivision_iters;
+    // rectangles this small are computed directly instead of split further
+    static constexpr int subdivision_min_size = 8;
+
+    // orbits of the pixels that had not escaped after `iteration` iterations,
+    // kept by compute_iterations when resumable is set
+    struct ResumeState {
+        int iteration = -1;
+        std::vector<size_t> settled; // inside by the analytic checks, never iterated
+        std::vector<size_t> pixels;
+        std::vector<double> zr;
+        std::vector<double> zi;
+    };
+    bool resumable = false;
+    ResumeState resume;
+
+    Viewport view;
+
+    // number type of the iteration, requested (may be Auto) and in use
+    kernel::Precision requested_precision = kernel::Precision::Double;
+    kernel::Precision precision = kernel::Precision::Double;
+
+    // the exact center as decimal strings, as double-double and the
+    // reference orbit of the perturbation mode
+    std::string center_re = "-0.5";
+    std::string center_im = "0";
+    DoubleDouble center_dd_re{-0.5};
+    DoubleDouble center_dd_im{0.0};
+    perturbation::ReferenceOrbit reference;
+    std::atomic<size_t> rebases{0};
+
+    // persistent threads for compute_iterations, spawned per call if not set
+    WorkerPool* pool = nullptr;
+
+    // escape data of the previous frame, see reuse_from
+    struct Reuse {
+        const IterationBuffer* buffer = nullptr;
+        Viewport view;
+        double tolerance = 0;
+    };
+    Reuse reuse;
+    size_t reused_pixels = 0;
+
+    // per thread statistics of the last compute call, see set_profiling
+    bool profiling = false;
+    Profile profile;
+    Stopwatch profile_clock;
+
+    // copy the rows mirrored at the real axis instead of computing them
+    bool symmetry = false;
+    size_t mirrored_pixels = 0;
+
+    // rows [begin, end) are copies of rows axis - y, see mirrored_rows
+    struct Mirror {
+        int axis = 0;
+        int begin = 0;
+        int end = 0;
+    };
 
 public:
-    Mandelbrot(int rows, int cols, int max_iterations): image(rows, cols, {255, 255, 255}), max_iterations(max_iterations) { }
+    Mandelbrot(int rows, int cols, int max_iterations): image(rows, cols, {255, 255, 255}), width(cols), height(rows), max_iterations(max_iterations) { }
+
+    // without the frame in memory, only compute_streaming can be used
+    Mandelbrot(int rows, int cols, int max_iterations, bool streaming)
+        : image(streaming ? 0 : rows, streaming ? 0 : cols, {255, 255, 255}), width(cols), height(rows), max_iterations(max_iterations) { }
+
+    void set_schedule(Schedule schedule, int tile_size = 32) {
+        this->schedule = schedule;
+        this->tile_size = tile_size;
+    }
+
+    // restricts the escape kernel, e.g. to the scalar path for debugging
+    void set_isa(kernel::Isa isa) {
+        this->isa = kernel::clamp(isa);
+    }
+
+    // analytic: points in the main cardioid or the period-2 bulb are inside
+    // without iterating, periodicity: orbits caught in a cycle stop early
+    void set_interior_checks(bool analytic, bool periodicity) {
+        analytic_checks = analytic;
+        periodicity_checks = periodicity;
+    }
+
+    void set_max_iterations(int max_iterations) {
+        this->max_iterations = max_iterations;
+        if (precision == kernel::Precision::Perturbation)
+            update_reference();
+    }
+
+    /**
+     * Shows the square pixel view of the given width (scale) around the
+     * center. The center is given as a decimal string, so it can carry more
+     * digits than a double for the double-double and perturbation modes.
+    */
+    void set_view(const std::string& center_re, const std::string& center_im, double scale) {
+        this->center_re = center_re;
+        this->center_im = center_im;
+        view.center_re = std::stod(center_re);
+        view.center_im = std::stod(center_im);
+        view.span_re = scale;
+        view.span_im = scale * height / width;
+        update_precision();
+    }
+
+    /**
+     * Number type of the iteration: float (twice the SIMD lanes), double,
+     * double-double (scalar), perturbation against a reference orbit for deep
+     * zooms, or Auto for the cheapest one that resolves the current view.
+    */
+    void set_precision(kernel::Precision precision) {
+        requested_precision = precision;
+        update_precision();
+    }
+
+    // iterate the pixels as double deltas against a high precision reference orbit
+    void set_perturbation(bool perturbation) {
+        set_precision(perturbation ? kernel::Precision::Perturbation : kernel::Precision::Double);
+    }
+
+    kernel::Precision get_precision() {
+        return precision;
+    }
+
+    // how often the perturbation mode had to rebase a pixel onto the reference
+    size_t get_rebases() {
+        return rebases;
+    }
+
+    double pixel_re(double x) const {
+        return view.center_re + (x / width - 0.5) * view.span_re;
+    }
+
+    double pixel_im(double y) const {
+        return view.center_im + (y / height - 0.5) * view.span_im;
+    }
+
+    // keep the orbits of unresolved pixels, so compute_iterations with a higher
+    // max_iterations only continues those instead of starting over
+    void set_resumable(bool resumable) {
+        this->resumable = resumable;
+        if (!resumable)
+            resume = ResumeState();
+    }
+
+    InteriorStats get_interior_stats() {
+        return interior_stats;
+    }
+
+    Viewport get_view() const {
+        return view;
+    }
+
+    // compute_iterations and resume_iterations run on the pool's threads
+    // (num_threads is ignored then), nullptr goes back to spawning threads
+    void set_pool(WorkerPool* pool) {
+        this->pool = pool;
+    }
+
+    /**
+     * Lets the next compute_iterations copy the escape data of pixels that
+     * lie on a pixel of the previous frame (at most tolerance pixels away),
+     * e.g. when panning by whole pixels or zooming by a power of 2. Both
+     * frames need the same max_iterations, the previous buffer must not change
+     * until compute_iterations returns. Only exact for a tolerance of 0, near
+     * the boundary a pixel copied from a slightly different point can differ.
+    */
+    void reuse_from(const IterationBuffer& previous, const Viewport& previous_view, double tolerance) {
+        reuse.buffer = &previous;
+        reuse.view = previous_view;
+        reuse.tolerance = tolerance;
+    }
+
+    // pixels copied from the previous frame by the last compute_iterations
+    size_t get_reused_pixels() {
+        return reused_pixels;
+    }
+
+    // records per thread busy/wait/idle time and work of compute,
+    // compute_tiles, compute_subdivision and compute_iterations
+    void set_profiling(bool profiling) {
+        this->profiling = profiling;
+    }
+
+    const Profile& get_profile() {
+        return profile;
+    }
+
+    // the set is symmetric to the real axis, compute_iterations only computes
+    // one side of it if the view straddles the axis
+    void set_symmetry(bool symmetry) {
+        this->symmetry = symmetry;
+    }
+
+    // pixels copied from their mirror image by the last compute_iterations
+    size_t get_mirrored_pixels() {
+        return mirrored_pixels;
+    }
 
     int compute(int num_threads = 1) {
+        if (schedule == Schedule::Tiles)
+            return compute_tiles(num_threads);
+        if (schedule == Schedule::Subdivision)
+            return compute_subdivision(num_threads);
+
+        begin_profile("modulo", num_threads);
 
         std::vector<std::thread> thrds;
         std::vector<std::vector<std::pair<size_t, size_t>>> thrd_procs_vec(num_threads);
@@ -40,6 +306,8 @@ public:
         // waiting for all the threads to be completed
         for (auto& t : thrds) 
             t.join();
+
+        end_profile();
         
         return pixels_inside;
 
@@ -49,28 +317,35 @@ public:
     int worker(std::vector<std::pair<size_t, size_t>> process, int num_threads, int thread_id=0)
     {
         size_t thread_px_cnt = 0;
+        InteriorStats stats;
+        Stopwatch busy;
+        busy.start();
         
         unsigned char color = (255*(thread_id+1))/num_threads; // comment this out if you want a single color
 
-        for (const auto& proc : process){
-            size_t x = proc.first;
-            size_t y = proc.second;
+        // pixels are fed to the escape kernel in batches, so it can iterate
+        // several of them per vector register
+        int xs[kernel::batch], ys[kernel::batch];
+        int n = 0;
 
-            double dx = ((double)x / image.width - 0.75) * 2.0;
-            double dy = ((double)y / image.height - 0.5) * 2.0;
-
-            std::complex<double> c(dx, dy);
+        for (const auto& proc : process){
+            xs[n] = proc.first;
+            ys[n] = proc.second;
 
-            if (check_pixel(c)) { 
-                image[y][x] = {color, color, color}; // {0, 0, 0} - black for a pixel inside of the mandelbrot set
-                thread_px_cnt++;
+            if (++n == kernel::batch) {
+                thread_px_cnt += render_batch(xs, ys, n, color, stats);
+                n = 0;
             }
-
         }
+        if (n)
+            thread_px_cnt += render_batch(xs, ys, n, color, stats);
+        busy.stop();
         
         // safely override the shared memory by mutex
         std::lock_guard<std::mutex> guard(mutex);
         pixels_inside += thread_px_cnt;
+        interior_stats += stats;
+        record_thread(thread_id, busy, Stopwatch(), 0, process.size(), stats);
 
         /*
         for (int y = 0; y < image.height; ++y) 
@@ -97,19 +372,1054 @@ public:
         return thread_px_cnt;
     }
 
-    // Test if point c belongs to the Mandelbrot set
-    bool check_pixel(std::complex<double> c)
+    int compute_tiles(int num_threads = 1) {
+        std::vector<std::thread> thrds;
+
+        // no per pixel coordinate lists, the threads pull whole tiles from
+        // the scheduler and steal from each other once they run dry
+        TileScheduler scheduler(image.width, image.height, tile_size, num_threads);
+        begin_profile("tiles", num_threads);
+
+        for (int i = 0; i < num_threads; i++){
+            thrds.push_back(std::thread(&Mandelbrot::tile_worker, this, std::ref(scheduler), num_threads, i));
+        }
+
+        for (auto& t : thrds) 
+            t.join();
+
+        end_profile();
+
+        return pixels_inside;
+    }
+
+    int tile_worker(TileScheduler& scheduler, int num_threads, int thread_id=0)
     {
-        std::complex<double> z(0, 0);
-        for (int i=0; i<max_iterations; ++i) {
-            z = z * z + c;
-            if ( std::abs(z) > 4 ) return false;
+        size_t thread_px_cnt = 0;
+        InteriorStats stats;
+
+        unsigned char color = (255*(thread_id+1))/num_threads;
+
+        int xs[kernel::batch], ys[kernel::batch];
+        Stopwatch busy, wait;
+        size_t tiles = 0, pixels = 0;
+
+        Tile tile;
+        while (next_tile(scheduler, thread_id, tile, wait)) {
+            busy.start();
+            for (int y = tile.y0; y < tile.y1; y++) {
+                for (int x0 = tile.x0; x0 < tile.x1; x0 += kernel::batch) {
+                    int n = std::min(kernel::batch, tile.x1 - x0);
+                    for (int i = 0; i < n; i++) {
+                        xs[i] = x0 + i;
+                        ys[i] = y;
+                    }
+                    thread_px_cnt += render_batch(xs, ys, n, color, stats);
+                }
+            }
+            busy.stop();
+            tiles++;
+            pixels += (size_t)(tile.x1 - tile.x0) * (tile.y1 - tile.y0);
+            scheduler.done();
         }
 
-        return true;
+        std::lock_guard<std::mutex> guard(mutex);
+        pixels_inside += thread_px_cnt;
+        interior_stats += stats;
+        record_thread(thread_id, busy, wait, tiles, pixels, stats);
+
+        return thread_px_cnt;
+    }
+
+    int compute_subdivision(int num_threads = 1) {
+        std::vector<std::thread> thrds;
+
+        subdivision_iters.assign((size_t)image.width * image.height, -1);
+
+        // the whole image is the first rectangle, its sub-rectangles are
+        // pushed as new tasks while the threads are already running
+        TileScheduler scheduler(num_threads);
+        scheduler.push(0, {0, 0, image.width, image.height});
+        begin_profile("subdivision", num_threads);
+
+        for (int i = 0; i < num_threads; i++){
+            thrds.push_back(std::thread(&Mandelbrot::subdivision_worker, this, std::ref(scheduler), num_threads, i));
+        }
+
+        for (auto& t : thrds) 
+            t.join();
+
+        end_profile();
+
+        subdivision_iters.clear();
+        subdivision_iters.shrink_to_fit();
+
+        return pixels_inside;
+    }
+
+    /**
+     * Mariani-Silver subdivision
+     *
+     * A rectangle arrives with its border already computed (except for the
+     * whole image, whose border is computed here). If every border pixel has
+     * the same escape count the interior is filled with it, otherwise the
+     * rectangle is split along its longer side: the split line is computed
+     * and both halves go back to the scheduler, so every pixel is computed or
+     * filled by exactly one thread.
+    */
+    int subdivision_worker(TileScheduler& scheduler, int num_threads, int thread_id=0)
+    {
+        size_t thread_px_cnt = 0;
+        InteriorStats stats;
+
+        unsigned char color = (255*(thread_id+1))/num_threads;
+
+        int xs[kernel::batch], ys[kernel::batch];
+        int n = 0;
+        Stopwatch busy, wait;
+        size_t tiles = 0, pixels = 0;
+
+        auto flush = [&]() {
+            thread_px_cnt += store_batch(xs, ys, n, color, stats);
+            pixels += n;
+            n = 0;
+        };
+        auto add = [&](int x, int y) {
+            xs[n] = x;
+            ys[n] = y;
+            if (++n == kernel::batch) flush();
+        };
+        auto at = [&](int x, int y) -> int& {
+            return subdivision_iters[(size_t)y * image.width + x];
+        };
+        auto for_border = [](const Tile& t, auto&& fn) {
+            for (int x = t.x0; x < t.x1; x++) {
+                fn(x, t.y0);
+                if (t.y1 - 1 > t.y0) fn(x, t.y1 - 1);
+            }
+            for (int y = t.y0 + 1; y < t.y1 - 1; y++) {
+                fn(t.x0, y);
+                if (t.x1 - 1 > t.x0) fn(t.x1 - 1, y);
+            }
+        };
+
+        Tile tile;
+        while (next_tile(scheduler, thread_id, tile, wait)) {
+            busy.start();
+            int w = tile.x1 - tile.x0;
+            int h = tile.y1 - tile.y0;
+
+            for_border(tile, [&](int x, int y) { if (at(x, y) < 0) add(x, y); });
+            flush();
+
+            if (w > 2 && h > 2) {
+                int value = at(tile.x0, tile.y0);
+                bool uniform = true;
+                for_border(tile, [&](int x, int y) { uniform = uniform && at(x, y) == value; });
+
+                if (uniform) {
+                    for (int y = tile.y0 + 1; y < tile.y1 - 1; y++) {
+                        for (int x = tile.x0 + 1; x < tile.x1 - 1; x++) {
+                            at(x, y) = value;
+                            if (value == max_iterations) image[y][x] = {color, color, color};
+                        }
+                    }
+                    if (value == max_iterations) thread_px_cnt += (size_t)(w - 2) * (h - 2);
+                } else if (w <= subdivision_min_size || h <= subdivision_min_size) {
+                    for (int y = tile.y0 + 1; y < tile.y1 - 1; y++)
+                        for (int x = tile.x0 + 1; x < tile.x1 - 1; x++)
+                            add(x, y);
+                    flush();
+                } else if (w >= h) {
+                    int mid = tile.x0 + w / 2;
+                    for (int y = tile.y0 + 1; y < tile.y1 - 1; y++) add(mid, y);
+                    flush();
+                    scheduler.push(thread_id, {tile.x0, tile.y0, mid + 1, tile.y1});
+                    scheduler.push(thread_id, {mid, tile.y0, tile.x1, tile.y1});
+                } else {
+                    int mid = tile.y0 + h / 2;
+                    for (int x = tile.x0 + 1; x < tile.x1 - 1; x++) add(x, mid);
+                    flush();
+                    scheduler.push(thread_id, {tile.x0, tile.y0, tile.x1, mid + 1});
+                    scheduler.push(thread_id, {tile.x0, mid, tile.x1, tile.y1});
+                }
+            }
+
+            busy.stop();
+            tiles++;
+            scheduler.done();
+        }
+
+        std::lock_guard<std::mutex> guard(mutex);
+        pixels_inside += thread_px_cnt;
+        interior_stats += stats;
+        record_thread(thread_id, busy, wait, tiles, pixels, stats);
+
+        return thread_px_cnt;
+    }
+
+    /**
+     * Escape data only, no colors
+     *
+     * Fills the buffer with the escape count of every pixel (and the smooth
+     * count if the buffer has room for it), independent of which thread did
+     * the work. Use colorize() to turn it into an image.
+    */
+    size_t compute_iterations(IterationBuffer& buffer, int num_threads = 1) {
+        // saved orbits are plain double, they only exist in double precision
+        if (resumable && precision == kernel::Precision::Double && resume.iteration >= 0 && resume.iteration <= max_iterations &&
+            buffer.height == height && buffer.width == width && buffer.max_iterations == resume.iteration)
+            return resume_iterations(buffer, num_threads);
+
+        if (buffer.height != height || buffer.width != width || buffer.max_iterations != max_iterations)
+            buffer = IterationBuffer(height, width, max_iterations, buffer.has_smooth());
+
+        if (pool)
+            num_threads = pool->size();
+        TileScheduler scheduler(width, height, tile_size, num_threads);
+        std::atomic<size_t> inside{0};
+        std::atomic<size_t> reused{0};
+
+        bool keep_orbits = resumable && precision == kernel::Precision::Double;
+        resume = ResumeState();
+        resume.iteration = keep_orbits ? max_iterations : -1;
+
+        // matching pixel of the previous frame per column and row, -1 if none
+        std::vector<int> previous_x, previous_y;
+        const IterationBuffer* previous = reuse.buffer;
+        reuse.buffer = nullptr;
+        if (previous && !keep_orbits && previous->max_iterations == max_iterations &&
+            (previous->has_smooth() || !buffer.has_smooth())) {
+            previous_x = previous_pixels(width, view.center_re - reuse.view.center_re, view.span_re,
+                                         previous->width, reuse.view.span_re);
+            previous_y = previous_pixels(height, view.center_im - reuse.view.center_im, view.span_im,
+                                         previous->height, reuse.view.span_im);
+        } else {
+            previous = nullptr;
+        }
+
+        // saved orbits would have to be mirrored as well
+        Mirror mirror = symmetry && !keep_orbits ? mirrored_rows() : Mirror();
+
+        begin_profile("iterations", num_threads);
+
+        auto iteration_worker = [&](int thread_id) {
+            size_t thread_px_cnt = 0;
+            size_t thread_reused = 0;
+            InteriorStats stats;
+            ResumeState unresolved;
+
+            int xs[kernel::batch], ys[kernel::batch], iters[kernel::batch];
+            double mags[kernel::batch], zrs[kernel::batch], zis[kernel::batch];
+            Stopwatch busy, wait;
+            size_t tiles = 0, pixels = 0;
+
+            Tile tile;
+            while (next_tile(scheduler, thread_id, tile, wait)) {
+                busy.start();
+                for (int y = tile.y0; y < tile.y1; y++) {
+                    if (y >= mirror.begin && y < mirror.end)
+                        continue;
+
+                    for (int x0 = tile.x0; x0 < tile.x1; x0 += kernel::batch) {
+                        int n = std::min(kernel::batch, tile.x1 - x0);
+                        int m = 0;
+                        for (int i = 0; i < n; i++) {
+                            int x = x0 + i;
+
+                            // copied from the previous frame, only the rest is iterated
+                            if (previous && previous_y[y] >= 0 && previous_x[x] >= 0) {
+                                size_t from = (size_t)previous_y[y] * previous->width + previous_x[x];
+                                buffer[y][x] = previous->counts[from];
+                                if (buffer.has_smooth()) buffer.smooth[(size_t)y * width + x] = previous->smooth[from];
+                                thread_px_cnt += previous->counts[from] == max_iterations;
+                                thread_reused++;
+                                continue;
+                            }
+
+                            xs[m] = x;
+                            ys[m++] = y;
+                        }
+                        escape_batch(xs, ys, m, iters, stats, buffer.has_smooth() ? mags : nullptr,
+                                     keep_orbits ? zrs : nullptr, keep_orbits ? zis : nullptr);
+                        pixels += m;
+
+                        uint16_t* counts = buffer[y];
+                        for (int i = 0; i < m; i++) {
+                            counts[xs[i]] = iters[i];
+                            thread_px_cnt += iters[i] == max_iterations;
+                        }
+
+                        if (keep_orbits) {
+                            for (int i = 0; i < m; i++) {
+                                if (iters[i] != max_iterations) continue;
+                                if (std::isnan(zrs[i])) {
+                                    unresolved.settled.push_back((size_t)y * width + xs[i]);
+                                    continue;
+                                }
+                                unresolved.pixels.push_back((size_t)y * width + xs[i]);
+                                unresolved.zr.push_back(zrs[i]);
+                                unresolved.zi.push_back(zis[i]);
+                            }
+                        }
+
+                        if (buffer.has_smooth()) {
+                            float* smooth = &buffer.smooth[(size_t)y * width];
+                            for (int i = 0; i < m; i++)
+                                smooth[xs[i]] = iters[i] == max_iterations ? 0.0f : smooth_count(iters[i], mags[i]);
+                        }
+                    }
+                }
+                busy.stop();
+                tiles++;
+                scheduler.done();
+            }
+
+            inside += thread_px_cnt;
+            reused += thread_reused;
+            std::lock_guard<std::mutex> guard(mutex);
+            interior_stats += stats;
+            append_resume_state(unresolved);
+            record_thread(thread_id, busy, wait, tiles, pixels, stats);
+        };
+
+        run_workers(num_threads, iteration_worker);
+        end_profile();
+
+        // the mirrored rows copy their computed counterparts
+        for (int y = mirror.begin; y < mirror.end; y++) {
+            int from = mirror.axis - y;
+            std::copy(buffer[from], buffer[from] + width, buffer[y]);
+            if (buffer.has_smooth())
+                std::copy(&buffer.smooth[(size_t)from * width], &buffer.smooth[(size_t)(from + 1) * width], &buffer.smooth[(size_t)y * width]);
+            inside += std::count(buffer[y], buffer[y] + width, max_iterations);
+        }
+
+        mirrored_pixels = (size_t)(mirror.end - mirror.begin) * width;
+        reused_pixels = reused;
+        return inside;
+    }
+
+    /**
+     * Rows of the view that mirror other rows at the real axis
+     *
+     * Row y shows the conjugate of row axis - y, with axis = height - 2 *
+     * center_im * height / span_im. That only lines up with the pixel grid if
+     * axis is an integer (the axis runs through a row or right between two).
+     * Of the two halves the one with more rows is computed, the mirrored part
+     * of the other half is returned, the rest of it (without a counterpart in
+     * the view) is computed as usual. Empty if the axis is not in the view.
+    */
+    Mirror mirrored_rows() const {
+        Mirror mirror;
+        double axis = height - 2.0 * view.center_im * height / view.span_im;
+        if (std::fabs(axis - std::round(axis)) > 1e-9 || axis < 0 || axis > 2.0 * (height - 1))
+            return mirror;
+
+        mirror.axis = (int)std::round(axis);
+
+        // either the rows below the axis copy the ones above, or the other way round
+        int upper_begin = mirror.axis / 2 + 1, upper_end = std::min(mirror.axis, height - 1) + 1;
+        int lower_begin = std::max(mirror.axis - (height - 1), 0), lower_end = (mirror.axis + 1) / 2;
+
+        if (upper_end - upper_begin >= lower_end - lower_begin) {
+            mirror.begin = upper_begin;
+            mirror.end = upper_end;
+        } else {
+            mirror.begin = lower_begin;
+            mirror.end = lower_end;
+        }
+        return mirror;
+    }
+
+    /**
+     * Escape data of one region of the frame only, e.g. a tile of a
+     * distributed render. buffer gets the size of the region, buffer[0][0]
+     * is pixel (x0, y0) of the frame; the threads take the region's rows.
+    */
+    size_t compute_region(IterationBuffer& buffer, const Tile& region, int num_threads = 1) {
+        int rows = region.y1 - region.y0;
+        int cols = region.x1 - region.x0;
+        if (buffer.height != rows || buffer.width != cols || buffer.max_iterations != max_iterations)
+            buffer = IterationBuffer(rows, cols, max_iterations, buffer.has_smooth());
+        if (pool)
+            num_threads = pool->size();
+
+        std::atomic<int> next_row{0};
+        std::atomic<size_t> inside{0};
+
+        auto region_worker = [&](int) {
+            size_t thread_px_cnt = 0;
+            InteriorStats stats;
+
+            int xs[kernel::batch], ys[kernel::batch], iters[kernel::batch];
+            double mags[kernel::batch];
+
+            for (int r = next_row++; r < rows; r = next_row++) {
+                for (int c0 = 0; c0 < cols; c0 += kernel::batch) {
+                    int n = std::min(kernel::batch, cols - c0);
+                    for (int i = 0; i < n; i++) {
+                        xs[i] = region.x0 + c0 + i;
+                        ys[i] = region.y0 + r;
+                    }
+                    escape_batch(xs, ys, n, iters, stats, buffer.has_smooth() ? mags : nullptr);
+
+                    for (int i = 0; i < n; i++) {
+                        buffer[r][c0 + i] = iters[i];
+                        thread_px_cnt += iters[i] == max_iterations;
+                        if (buffer.has_smooth())
+                            buffer.smooth[(size_t)r * cols + c0 + i] = iters[i] == max_iterations ? 0.0f : smooth_count(iters[i], mags[i]);
+                    }
+                }
+            }
+
+            inside += thread_px_cnt;
+            std::lock_guard<std::mutex> guard(mutex);
+            interior_stats += stats;
+        };
+        run_workers(num_threads, region_worker);
+
+        return inside;
+    }
+
+    /**
+     * For every pixel along one axis the pixel of the previous frame at the
+     * same coordinate, -1 if there is none within the reuse tolerance. offset
+     * is the current center minus the previous one.
+    */
+    std::vector<int> previous_pixels(int size, double offset, double span, int previous_size, double previous_span) const {
+        std::vector<int> previous(size, -1);
+        for (int p = 0; p < size; p++) {
+            double pos = ((offset + ((double)p / size - 0.5) * span) / previous_span + 0.5) * previous_size;
+            double nearest = std::round(pos);
+            if (std::fabs(pos - nearest) <= reuse.tolerance && nearest >= 0 && nearest < previous_size)
+                previous[p] = (int)nearest;
+        }
+        return previous;
+    }
+
+    // scheduler.next, with the time it took added to wait
+    static bool next_tile(TileScheduler& scheduler, int thread_id, Tile& tile, Stopwatch& wait) {
+        wait.start();
+        bool found = scheduler.next(thread_id, tile);
+        wait.stop();
+        return found;
+    }
+
+    void begin_profile(const std::string& mode, int num_threads) {
+        if (!profiling)
+            return;
+        profile = Profile();
+        profile.mode = mode;
+        profile.threads.resize(num_threads);
+        profile_clock = Stopwatch();
+        profile_clock.start();
+    }
+
+    // the caller holds mutex
+    void record_thread(int thread_id, const Stopwatch& busy, const Stopwatch& wait, size_t tiles, size_t pixels, const InteriorStats& stats) {
+        if (!profiling)
+            return;
+        ThreadStats& t = profile.threads[thread_id];
+        t.busy = busy.seconds;
+        t.wait = wait.seconds;
+        t.tiles = tiles;
+        t.pixels = pixels;
+        t.iterations = stats.iterations;
+    }
+
+    void end_profile() {
+        if (!profiling)
+            return;
+        profile_clock.stop();
+        profile.wall = profile_clock.seconds;
+        for (auto& t : profile.threads)
+            t.idle = std::max(0.0, profile.wall - t.busy - t.wait);
+    }
+
+    // runs worker(thread_id) on the pool or on num_threads fresh threads
+    void run_workers(int num_threads, const std::function<void(int)>& worker) {
+        if (pool) {
+            pool->run(worker);
+            return;
+        }
+
+        std::vector<std::thread> thrds;
+        for (int i = 0; i < num_threads; i++)
+            thrds.emplace_back(worker, i);
+
+        for (auto& t : thrds)
+            t.join();
+    }
+
+    /**
+     * Progressive rendering for a quick preview
+     *
+     * The first level computes every start_stride-th pixel in both directions,
+     * every following level halves the stride and only computes the pixels
+     * that are new on its grid, so every pixel is still iterated exactly once.
+     * After each level the pixels not computed yet are filled with the value
+     * of the computed pixel above left of them and on_level(buffer, stride) is
+     * called on the calling thread; the buffer is complete once stride is 1.
+    */
+    size_t compute_progressive(IterationBuffer& buffer, int num_threads,
+                               const std::function<void(const IterationBuffer&, int)>& on_level, int start_stride = 8)
+    {
+        if (buffer.height != height || buffer.width != width || buffer.max_iterations != max_iterations)
+            buffer = IterationBuffer(height, width, max_iterations, buffer.has_smooth());
+        if (pool)
+            num_threads = pool->size();
+
+        // power of 2, so the grids of all levels are nested
+        int stride = 1;
+        while (stride * 2 <= start_stride) stride *= 2;
+
+        std::atomic<size_t> inside{0};
+
+        for (bool first = true; stride >= 1; stride /= 2, first = false) {
+            std::atomic<int> next_row{0};
+
+            // rows of the level's grid, the odd ones of the coarser grid are new entirely
+            auto level_worker = [&](int) {
+                size_t thread_px_cnt = 0;
+                InteriorStats stats;
+
+                int xs[kernel::batch], ys[kernel::batch], iters[kernel::batch];
+                double mags[kernel::batch];
+                int n = 0;
+
+                auto flush = [&]() {
+                    escape_batch(xs, ys, n, iters, stats, buffer.has_smooth() ? mags : nullptr);
+                    for (int i = 0; i < n; i++) {
+                        buffer[ys[i]][xs[i]] = iters[i];
+                        thread_px_cnt += iters[i] == max_iterations;
+                        if (buffer.has_smooth())
+                            buffer.smooth[(size_t)ys[i] * width + xs[i]] = iters[i] == max_iterations ? 0.0f : smooth_count(iters[i], mags[i]);
+                    }
+                    n = 0;
+                };
+
+                for (int y = next_row++ * stride; y < height; y = next_row++ * stride) {
+                    bool new_row = first || (y / stride) % 2 == 1;
+                    for (int x = new_row ? 0 : stride; x < width; x += new_row ? stride : 2 * stride) {
+                        xs[n] = x;
+                        ys[n] = y;
+                        if (++n == kernel::batch) flush();
+                    }
+                    flush();
+                }
+
+                inside += thread_px_cnt;
+                std::lock_guard<std::mutex> guard(mutex);
+                interior_stats += stats;
+            };
+            run_workers(num_threads, level_worker);
+
+            // upscale: the rest of every stride x stride block copies its corner
+            if (stride > 1) {
+                auto fill_worker = [&](int thread_id) {
+                    for (int y = thread_id; y < height; y += num_threads) {
+                        size_t from_row = (size_t)(y - y % stride) * width;
+                        for (int x = 0; x < width; x++) {
+                            if (x % stride == 0 && y % stride == 0) continue;
+                            size_t from = from_row + x - x % stride;
+                            buffer.counts[(size_t)y * width + x] = buffer.counts[from];
+                            if (buffer.has_smooth()) buffer.smooth[(size_t)y * width + x] = buffer.smooth[from];
+                        }
+                    }
+                };
+                run_workers(num_threads, fill_worker);
+            }
+
+            if (on_level)
+                on_level(buffer, stride);
+        }
+
+        return inside;
+    }
+
+    /**
+     * Continues the saved orbits up to the current max_iterations
+     *
+     * Only the pixels that had not escaped are iterated, starting from their
+     * saved z. The threads take chunks of the saved pixels, the ones still not
+     * escaped are saved again for the next call.
+    */
+    size_t resume_iterations(IterationBuffer& buffer, int num_threads = 1) {
+        if (max_iterations > UINT16_MAX)
+            throw std::invalid_argument("Iteration buffer holds at most 65535 iterations");
+
+        ResumeState previous;
+        std::swap(previous, resume);
+        resume.iteration = max_iterations;
+        std::swap(resume.settled, previous.settled);
+
+        // the settled pixels stay inside, whatever the limit
+        buffer.max_iterations = max_iterations;
+        for (size_t px : resume.settled)
+            buffer.counts[px] = max_iterations;
+
+        const size_t chunk = 16 * kernel::batch;
+        std::atomic<size_t> next_chunk{0};
+
+        auto resume_worker = [&](int) {
+            InteriorStats stats;
+            ResumeState unresolved;
+
+            double cr[kernel::batch], ci[kernel::batch], zr[kernel::batch], zi[kernel::batch], mags[kernel::batch];
+            int iters[kernel::batch];
+
+            for (size_t begin = next_chunk.fetch_add(chunk); begin < previous.pixels.size(); begin = next_chunk.fetch_add(chunk)) {
+                size_t end = std::min(begin + chunk, previous.pixels.size());
+
+                for (size_t b = begin; b < end; b += kernel::batch) {
+                    int n = std::min<size_t>(kernel::batch, end - b);
+                    for (int i = 0; i < n; i++) {
+                        size_t px = previous.pixels[b + i];
+                        cr[i] = pixel_re(px % width);
+                        ci[i] = pixel_im(px / width);
+                        zr[i] = previous.zr[b + i];
+                        zi[i] = previous.zi[b + i];
+                    }
+
+                    kernel::Orbit orbit{zr, zi, previous.iteration};
+                    stats.periodic += kernel::escape(isa, cr, ci, n, iters, max_iterations, periodicity_checks,
+                                                     buffer.has_smooth() ? mags : nullptr, &orbit).points;
+
+                    for (int i = 0; i < n; i++) {
+                        size_t px = previous.pixels[b + i];
+                        buffer.counts[px] = iters[i];
+                        if (iters[i] != max_iterations) {
+                            if (buffer.has_smooth()) buffer.smooth[px] = smooth_count(iters[i], mags[i]);
+                            continue;
+                        }
+                        unresolved.pixels.push_back(px);
+                        unresolved.zr.push_back(zr[i]);
+                        unresolved.zi.push_back(zi[i]);
+                    }
+                }
+            }
+
+            std::lock_guard<std::mutex> guard(mutex);
+            interior_stats += stats;
+            append_resume_state(unresolved);
+        };
+
+        run_workers(num_threads, resume_worker);
+
+        return resume.settled.size() + resume.pixels.size();
+    }
+
+    // merges a thread's unresolved pixels into resume, the caller holds mutex
+    void append_resume_state(const ResumeState& unresolved) {
+        if (resume.iteration < 0)
+            return;
+        resume.settled.insert(resume.settled.end(), unresolved.settled.begin(), unresolved.settled.end());
+        resume.pixels.insert(resume.pixels.end(), unresolved.pixels.begin(), unresolved.pixels.end());
+        resume.zr.insert(resume.zr.end(), unresolved.zr.begin(), unresolved.zr.end());
+        resume.zi.insert(resume.zi.end(), unresolved.zi.begin(), unresolved.zi.end());
+    }
+
+    // fractional escape count from the escape iteration and |z|^2 at escape
+    static float smooth_count(int iteration, double mag) {
+        double nu = iteration + 1 - std::log2(0.5 * std::log(mag));
+        return nu < 0 ? 0.0f : (float)nu;
+    }
+
+    // turns escape data from compute_iterations into the image
+    void colorize(const IterationBuffer& buffer, const Palette& palette, int num_threads = 1) {
+        ::colorize(buffer, image, palette, num_threads);
+    }
+
+    /**
+     * Adaptive anti-aliasing of an image colorized from buffer
+     *
+     * Only pixels whose escape data differs from one of their 8 neighbours
+     * (inside vs outside, a different count, or smooth counts more than 1
+     * apart) are supersampled: samples jittered points, one per cell of a
+     * square grid over the pixel, are iterated one by one like check_pixel
+     * and their colors averaged. With all_pixels every pixel is supersampled,
+     * as a reference. Returns how many pixels were supersampled.
+    */
+    size_t antialias(const IterationBuffer& buffer, const Palette& palette, int samples, int num_threads = 1, bool all_pixels = false) {
+        if (pool)
+            num_threads = pool->size();
+
+        int grid = std::max(1, (int)std::lround(std::sqrt(samples)));
+
+        auto differs = [&](size_t a, size_t b) {
+            if ((buffer.counts[a] == max_iterations) != (buffer.counts[b] == max_iterations))
+                return true;
+            if (buffer.has_smooth())
+                return std::fabs(buffer.smooth[a] - buffer.smooth[b]) > 1.0f;
+            return buffer.counts[a] != buffer.counts[b];
+        };
+
+        std::vector<size_t> edges;
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                size_t px = (size_t)y * width + x;
+                bool edge = all_pixels;
+                for (int dy = -1; dy <= 1 && !edge; dy++) {
+                    for (int dx = -1; dx <= 1 && !edge; dx++) {
+                        int nx = x + dx, ny = y + dy;
+                        if (nx >= 0 && nx < width && ny >= 0 && ny < height)
+                            edge = differs(px, (size_t)ny * width + nx);
+                    }
+                }
+                if (edge) edges.push_back(px);
+            }
+        }
+
+        const size_t chunk = 64;
+        std::atomic<size_t> next_chunk{0};
+
+        auto sample_worker = [&](int) {
+            for (size_t begin = next_chunk.fetch_add(chunk); begin < edges.size(); begin = next_chunk.fetch_add(chunk)) {
+                for (size_t e = begin; e < std::min(begin + chunk, edges.size()); e++) {
+                    size_t px = edges[e];
+                    int x = px % width, y = px / width;
+
+                    // jitter seeded by the pixel, the result does not depend on the threads
+                    std::minstd_rand rng(px + 1);
+                    std::uniform_real_distribution<double> jitter(0.0, 1.0);
+
+                    unsigned int r = 0, g = 0, b = 0;
+                    for (int sy = 0; sy < grid; sy++) {
+                        for (int sx = 0; sx < grid; sx++) {
+                            double fx = x - 0.5 + (sx + jitter(rng)) / grid;
+                            double fy = y - 0.5 + (sy + jitter(rng)) / grid;
+                            double mag;
+                            int count = escape_sample(fx, fy, mag);
+                            float smooth = buffer.has_smooth() && count != max_iterations ? smooth_count(count, mag) : -1.0f;
+
+                            Pixel color = palette.shade(count, smooth, max_iterations);
+                            r += color.r;
+                            g += color.g;
+                            b += color.b;
+                        }
+                    }
+
+                    int n = grid * grid;
+                    image.data[px] = {(unsigned char)((r + n / 2) / n), (unsigned char)((g + n / 2) / n), (unsigned char)((b + n / 2) / n)};
+                }
+            }
+        };
+        run_workers(num_threads, sample_worker);
+
+        return edges.size();
+    }
+
+    // escape count of the point at the fractional pixel position (x, y),
+    // scalar like check_pixel, against the reference in perturbation mode
+    int escape_sample(double x, double y, double& mag) {
+        if (precision == kernel::Precision::Perturbation) {
+            size_t sample_rebases = 0;
+            int count = perturbation::escape_delta(reference, (x / width - 0.5) * view.span_re, (y / height - 0.5) * view.span_im,
+                                                   max_iterations, mag, sample_rebases);
+            rebases += sample_rebases;
+            return count;
+        }
+
+        double cr = pixel_re(x), ci = pixel_im(y);
+        mag = 0;
+        if (analytic_checks && (kernel::in_main_cardioid(cr, ci) || kernel::in_period2_bulb(cr, ci)))
+            return max_iterations;
+
+        double zr = 0, zi = 0;
+        int cycle_at;
+        return kernel::escape_one(cr, ci, zr, zi, 0, max_iterations, periodicity_checks, cycle_at, mag);
+    }
+
+    /**
+     * Out-of-core rendering straight into a binary ppm
+     *
+     * The frame is rendered in horizontal bands of band_height rows, with at
+     * most bands_in_flight of them in memory. The threads take rows one by one;
+     * the thread finishing the last row of a band hands it to the calling
+     * thread, which writes it at its offset in the file while later bands are
+     * still being computed. A band can only start once the band using the same
+     * buffer before it has been written.
+    */
+    size_t compute_streaming(std::string filename, int num_threads = 1, int band_height = 256, int bands_in_flight = 4) {
+        band_height = std::max(1, std::min(band_height, height));
+        bands_in_flight = std::max(1, bands_in_flight);
+
+        int num_bands = (height + band_height - 1) / band_height;
+        size_t row_bytes = (size_t)width * sizeof(Pixel);
+
+        std::vector<Image> slots;
+        for (int i = 0; i < std::min(bands_in_flight, num_bands); i++)
+            slots.emplace_back(band_height, width, Pixel{255, 255, 255});
+
+        std::vector<std::atomic<int>> rows_left(num_bands);
+        for (int b = 0; b < num_bands; b++)
+            rows_left[b] = std::min(band_height, height - b * band_height);
+
+        std::mutex band_mutex;
+        std::condition_variable band_cv;
+        std::vector<char> written(num_bands, 0);
+        std::deque<int> ready;
+        std::atomic<int> next_row{0};
+        std::atomic<size_t> inside{0};
+
+        auto row_worker = [&](int thread_id) {
+            size_t thread_px_cnt = 0;
+            InteriorStats stats;
+            unsigned char color = (255*(thread_id+1))/num_threads;
+
+            int xs[kernel::batch], ys[kernel::batch], iters[kernel::batch];
+
+            for (int y = next_row++; y < height; y = next_row++) {
+                int band = y / band_height;
+                Image& slot = slots[band % slots.size()];
+
+                if (band >= (int)slots.size()) {
+                    std::unique_lock<std::mutex> lock(band_mutex);
+                    band_cv.wait(lock, [&]() { return written[band - slots.size()]; });
+                }
+
+                Pixel* row = slot[y - band * band_height];
+                for (int x0 = 0; x0 < width; x0 += kernel::batch) {
+                    int n = std::min(kernel::batch, width - x0);
+                    for (int i = 0; i < n; i++) {
+                        xs[i] = x0 + i;
+                        ys[i] = y;
+                    }
+                    escape_batch(xs, ys, n, iters, stats);
+
+                    for (int i = 0; i < n; i++) {
+                        if (iters[i] == max_iterations) {
+                            row[xs[i]] = {color, color, color};
+                            thread_px_cnt++;
+                        } else {
+                            row[xs[i]] = {255, 255, 255};
+                        }
+                    }
+                }
+
+                if (--rows_left[band] == 0) {
+                    std::lock_guard<std::mutex> guard(band_mutex);
+                    ready.push_back(band);
+                    band_cv.notify_all();
+                }
+            }
+
+            inside += thread_px_cnt;
+            std::lock_guard<std::mutex> guard(mutex);
+            interior_stats += stats;
+        };
+
+        std::string header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+        int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            throw std::runtime_error("Could not open " + filename);
+        bool ok = Image::write_at(fd, header.data(), header.size(), 0);
+
+        std::vector<std::thread> thrds;
+        for (int i = 0; i < num_threads; i++)
+            thrds.emplace_back(row_worker, i);
+
+        // the calling thread is the writer
+        for (int done = 0; done < num_bands; done++) {
+            int band;
+            {
+                std::unique_lock<std::mutex> lock(band_mutex);
+                band_cv.wait(lock, [&]() { return !ready.empty(); });
+                band = ready.front();
+                ready.pop_front();
+            }
+
+            int rows = std::min(band_height, height - band * band_height);
+            ok = ok && Image::write_at(fd, slots[band % slots.size()].data.data(), row_bytes * rows,
+                                       header.size() + row_bytes * band * band_height);
+
+            std::lock_guard<std::mutex> guard(band_mutex);
+            written[band] = 1;
+            band_cv.notify_all();
+        }
+
+        for (auto& t : thrds)
+            t.join();
+
+        close(fd);
+        if (!ok)
+            throw std::runtime_error("Could not write " + filename);
+
+        return inside;
+    }
+
+    // escape counts for up to kernel::batch pixels, points settled by the
+    // analytic checks get max_iterations without running the kernel. If zrs
+    // and zis are given they receive z where every orbit stopped (NaN for the
+    // analytic ones).
+    void escape_batch(const int* xs, const int* ys, int n, int* iters, InteriorStats& stats, double* mags = nullptr,
+                      double* zrs = nullptr, double* zis = nullptr)
+    {
+        switch (precision) {
+            case kernel::Precision::Perturbation:
+                return escape_batch_perturbation(xs, ys, n, iters, stats, mags);
+            case kernel::Precision::Float:
+                return escape_batch_typed<float>(xs, ys, n, iters, stats, mags);
+            case kernel::Precision::DoubleDouble:
+                return escape_batch_typed<DoubleDouble>(xs, ys, n, iters, stats, mags);
+            default:
+                return escape_batch_typed<double>(xs, ys, n, iters, stats, mags, zrs, zis);
+        }
+    }
+
+    // the escape_batch of one number type, orbits can only be kept for double
+    template<typename T>
+    void escape_batch_typed(const int* xs, const int* ys, int n, int* iters, InteriorStats& stats, double* mags = nullptr,
+                            double* zrs = nullptr, double* zis = nullptr)
+    {
+        T cr[kernel::batch], ci[kernel::batch];
+        double kernel_mags[kernel::batch];
+        double kernel_zr[kernel::batch] = {}, kernel_zi[kernel::batch] = {};
+        int kernel_iters[kernel::batch];
+        int idx[kernel::batch];
+        int m = 0;
+
+        for (int i = 0; i < n; i++) {
+            double dx = pixel_re(xs[i]);
+            double dy = pixel_im(ys[i]);
+
+            // only the points not settled analytically go to the kernel
+            if (analytic_checks && kernel::in_main_cardioid(dx, dy)) {
+                stats.cardioid++;
+                iters[i] = max_iterations;
+                if (mags) mags[i] = 0;
+                if (zrs) zrs[i] = zis[i] = NAN;
+            } else if (analytic_checks && kernel::in_period2_bulb(dx, dy)) {
+                stats.bulb++;
+                iters[i] = max_iterations;
+                if (mags) mags[i] = 0;
+                if (zrs) zrs[i] = zis[i] = NAN;
+            } else {
+                cr[m] = pixel_coordinate<T>(xs[i], view.center_re, center_dd_re, width, view.span_re);
+                ci[m] = pixel_coordinate<T>(ys[i], view.center_im, center_dd_im, height, view.span_im);
+                idx[m++] = i;
+            }
+        }
+
+        kernel::Cycles cycles;
+        if constexpr (std::is_same<T, double>::value) {
+            kernel::Orbit orbit{kernel_zr, kernel_zi, 0};
+            cycles = kernel::escape(isa, cr, ci, m, kernel_iters, max_iterations, periodicity_checks,
+                                    mags ? kernel_mags : nullptr, zrs ? &orbit : nullptr);
+        } else {
+            cycles = kernel::escape(isa, cr, ci, m, kernel_iters, max_iterations, periodicity_checks,
+                                    mags ? kernel_mags : nullptr);
+        }
+        stats.periodic += cycles.points;
+
+        for (int k = 0; k < m; k++) {
+            stats.iterations += kernel_iters[k];
+            iters[idx[k]] = kernel_iters[k];
+            if (mags) mags[idx[k]] = kernel_mags[k];
+            if (zrs) {
+                zrs[idx[k]] = kernel_zr[k];
+                zis[idx[k]] = kernel_zi[k];
+            }
+        }
+        // the orbits caught in a cycle report max_iterations but stopped early
+        stats.iterations -= cycles.skipped;
+    }
+
+    // deltas are taken against the exact center, which is the reference point
+    void escape_batch_perturbation(const int* xs, const int* ys, int n, int* iters, InteriorStats& stats, double* mags)
+    {
+        size_t batch_rebases = 0;
+        for (int i = 0; i < n; i++) {
+            double dcr = ((double)xs[i] / width - 0.5) * view.span_re;
+            double dci = ((double)ys[i] / height - 0.5) * view.span_im;
+            double mag;
+            iters[i] = perturbation::escape_delta(reference, dcr, dci, max_iterations, mag, batch_rebases);
+            stats.iterations += iters[i];
+            if (mags) mags[i] = mag;
+        }
+        rebases += batch_rebases;
+    }
+
+    // coordinate of pixel index p along one axis, double-double adds the
+    // offset to the exact center instead of the rounded one
+    template<typename T>
+    static T pixel_coordinate(int p, double center, const DoubleDouble& center_dd, int size, double span) {
+        if constexpr (std::is_same<T, DoubleDouble>::value)
+            return center_dd + DoubleDouble(((double)p / size - 0.5) * span);
+        else
+            return (T)(center + ((double)p / size - 0.5) * span);
+    }
+
+    void update_precision() {
+        precision = requested_precision;
+        if (precision == kernel::Precision::Auto) {
+            double spacing = std::min(view.span_re / width, view.span_im / height);
+            precision = kernel::choose_precision(spacing, std::hypot(view.center_re, view.center_im));
+        }
+
+        if (precision == kernel::Precision::DoubleDouble) {
+            center_dd_re = to_double_double(center_re);
+            center_dd_im = to_double_double(center_im);
+        }
+        if (precision == kernel::Precision::Perturbation)
+            update_reference();
+    }
+
+    static DoubleDouble to_double_double(const std::string& value) {
+        const int limbs = 6;
+        double hi = std::stod(value);
+        double lo = (Fixed::from_string(value, limbs) - Fixed::from_double(hi, limbs)).to_double();
+        return {hi, lo};
+    }
+
+    void update_reference() {
+        double spacing = std::min(view.span_re / width, view.span_im / height);
+        reference = perturbation::reference_orbit(center_re, center_im, spacing, max_iterations);
+    }
+
+    // runs the escape kernel on up to kernel::batch pixels, colors the ones
+    // inside of the set and returns how many there were
+    size_t render_batch(const int* xs, const int* ys, int n, unsigned char color, InteriorStats& stats)
+    {
+        int iters[kernel::batch];
+        escape_batch(xs, ys, n, iters, stats);
+
+        size_t inside = 0;
+        for (int i = 0; i < n; i++) {
+            if (iters[i] == max_iterations) {
+                image[ys[i]][xs[i]] = {color, color, color};
+                inside++;
+            }
+        }
+        return inside;
+    }
+
+    // same as render_batch, but also keeps the escape counts for the subdivision
+    size_t store_batch(const int* xs, const int* ys, int n, unsigned char color, InteriorStats& stats)
+    {
+        int iters[kernel::batch];
+        escape_batch(xs, ys, n, iters, stats);
+
+        size_t inside = 0;
+        for (int i = 0; i < n; i++) {
+            subdivision_iters[(size_t)ys[i] * image.width + xs[i]] = iters[i];
+            if (iters[i] == max_iterations) {
+                image[ys[i]][xs[i]] = {color, color, color};
+                inside++;
+            }
+        }
+        return inside;
+    }
+
+    // Test if point c belongs to the Mandelbrot set
+    bool check_pixel(std::complex<double> c)
+    {
+        return kernel::escape_one(c.real(), c.imag(), max_iterations) == max_iterations;
     };
 
-    void save_to_ppm(std::string filename){
-        image.save_to_ppm(filename);
+    void save_to_ppm(std::string filename, PpmFormat format = PpmFormat::Binary, int num_threads = 1){
+        image.save_to_ppm(filename, format, num_threads);
     }
-};
\ No newline at end of file
+};
+
+#endif
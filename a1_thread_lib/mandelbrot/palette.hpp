@@ -0,0 +1,91 @@
+#include <vector>
+#include <cmath>
+#include <thread>
+
+#include "pixel.hpp"
+#include "image.hpp"
+#include "iterations.hpp"
+
+#ifndef _PALETTE_
+#define _PALETTE_
+
+/**
+ * Colors for escape counts, repeated cyclically, inside gets its own color
+*/
+struct Palette {
+    std::vector<Pixel> colors;
+    Pixel inside{0, 0, 0};
+
+    // color of a single sample, smooth is the fractional count or negative for the raw one
+    Pixel shade(int count, float smooth, int max_iterations) const {
+        if (count == max_iterations)
+            return inside;
+
+        size_t size = colors.size();
+        if (smooth < 0)
+            return colors[count % size];
+
+        size_t idx = (size_t)smooth;
+        float t = smooth - idx;
+        const Pixel& a = colors[idx % size];
+        const Pixel& b = colors[(idx + 1) % size];
+        return {(unsigned char)(a.r + t * (b.r - a.r)),
+                (unsigned char)(a.g + t * (b.g - a.g)),
+                (unsigned char)(a.b + t * (b.b - a.b))};
+    }
+
+    // smooth cyclic gradient through blue, white and orange
+    static Palette gradient(int size = 256) {
+        Palette palette;
+        for (int i = 0; i < size; i++) {
+            double t = 2.0 * M_PI * i / size;
+            palette.colors.push_back({
+                (unsigned char)(127.5 - 127.5 * std::cos(t)),
+                (unsigned char)(127.5 - 110.0 * std::cos(t + 0.6)),
+                (unsigned char)(127.5 + 127.5 * std::cos(t + 1.2))
+            });
+        }
+        return palette;
+    }
+};
+
+/**
+ * Maps an iteration buffer to pixels
+ *
+ * For raw counts the palette is expanded into a lookup table with one entry
+ * per count (inside at max_iterations), so the loop is a plain branch-free
+ * table lookup. Smooth counts are interpolated between two palette entries.
+ * The image is split into row bands, one per thread.
+*/
+void colorize(const IterationBuffer& iterations, Image& image, const Palette& palette, int num_threads = 1) {
+    size_t size = palette.colors.size();
+
+    std::vector<Pixel> lut(iterations.max_iterations + 1, palette.inside);
+    for (int i = 0; i < iterations.max_iterations; i++)
+        lut[i] = palette.colors[i % size];
+
+    auto band = [&](size_t begin, size_t end) {
+        const uint16_t* counts = iterations.counts.data();
+        Pixel* out = image.data.data();
+
+        if (!iterations.has_smooth()) {
+            for (size_t i = begin; i < end; i++)
+                out[i] = lut[counts[i]];
+            return;
+        }
+
+        const float* smooth = iterations.smooth.data();
+        for (size_t i = begin; i < end; i++)
+            out[i] = palette.shade(counts[i], smooth[i], iterations.max_iterations);
+    };
+
+    size_t total = iterations.counts.size();
+    std::vector<std::thread> thrds;
+    for (int i = 0; i < num_threads; i++)
+        thrds.emplace_back(band, total * i / num_threads, total * (i + 1) / num_threads);
+
+    for (auto& t : thrds)
+        t.join();
+}
+
+#endif
@@ -0,0 +1,106 @@
+#include <vector>
+#include <string>
+#include <cmath>
+
+#include "fixed_point.hpp"
+
+#ifndef _PERTURBATION_
+#define _PERTURBATION_
+
+/**
+ * Perturbation theory for deep zooms
+ *
+ * Only the reference point C (the center of the view) is iterated in high
+ * precision: Z_{n+1} = Z_n^2 + C. Every pixel c = C + dc is then iterated as a
+ * small double delta against that orbit, z_n = Z_n + d_n with
+ *
+ *     d_{n+1} = (2 Z_n + d_n) d_n + dc
+ *
+ * which only needs double precision for dc and d_n, however small they are.
+ * When the pixel's orbit comes closer to 0 than the delta itself, the delta
+ * loses its precision against the reference (a glitch). It is then rebased:
+ * d = z and the reference restarts at Z_0 = 0. The same happens once the pixel
+ * runs past the end of the reference orbit (the reference escaped earlier).
+ * This keeps 1e-100 zooms at roughly double speed, limited by the exponent
+ * range of double (about 1e-300).
+*/
+namespace perturbation {
+
+    // reference orbit Z_0 .. Z_L rounded to double, L <= max_iterations
+    struct ReferenceOrbit {
+        std::vector<double> zr;
+        std::vector<double> zi;
+    };
+
+    // 32 bit limbs for the reference, enough to resolve a pixel spacing
+    inline int limbs_for(double spacing) {
+        int bits = (int)std::ceil(-std::log2(spacing)) + 64;
+        return std::max(4, bits / 32 + 2);
+    }
+
+    inline ReferenceOrbit reference_orbit(const std::string& center_re, const std::string& center_im, double spacing, int max_iterations) {
+        int limbs = limbs_for(spacing);
+        Fixed cr = Fixed::from_string(center_re, limbs);
+        Fixed ci = Fixed::from_string(center_im, limbs);
+        Fixed zr(limbs), zi(limbs);
+
+        ReferenceOrbit orbit;
+        orbit.zr.push_back(0);
+        orbit.zi.push_back(0);
+
+        for (int i = 0; i < max_iterations; i++) {
+            Fixed zr2 = zr * zr;
+            Fixed zi2 = zi * zi;
+            Fixed zri = zr * zi;
+            zi = zri + zri + ci;
+            zr = zr2 - zi2 + cr;
+
+            double re = zr.to_double();
+            double im = zi.to_double();
+            orbit.zr.push_back(re);
+            orbit.zi.push_back(im);
+
+            if (re * re + im * im > 16.0) break;
+        }
+        return orbit;
+    }
+
+    // same contract as kernel::escape_one, for the pixel at offset (dcr, dci) from the reference
+    inline int escape_delta(const ReferenceOrbit& ref, double dcr, double dci, int max_iterations, double& mag, size_t& rebases) {
+        const double* ref_r = ref.zr.data();
+        const double* ref_i = ref.zi.data();
+        const int last = ref.zr.size() - 1;
+
+        double dr = 0, di = 0;
+        int m = 0;
+        mag = 0;
+
+        for (int i = 0; i < max_iterations; ++i) {
+            double tr = 2.0 * ref_r[m] + dr;
+            double ti = 2.0 * ref_i[m] + di;
+            double nr = tr * dr - ti * di + dcr;
+            double ni = tr * di + ti * dr + dci;
+            dr = nr;
+            di = ni;
+            m++;
+
+            double zr = ref_r[m] + dr;
+            double zi = ref_i[m] + di;
+            double zmag = zr * zr + zi * zi;
+            if (zmag > 16.0) {
+                mag = zmag;
+                return i;
+            }
+
+            if (zmag < dr * dr + di * di || m == last) {
+                dr = zr;
+                di = zi;
+                m = 0;
+                rebases++;
+            }
+        }
+        return max_iterations;
+    }
+}
+
+#endif
@@ -17,6 +17,8 @@ struct Pixel {
         b = li.size() > 2 ? *(++it) : 0;
     }
 
+    Pixel(Pixel const& p) = default;
+
     Pixel& operator=(Pixel const& p) {
         r = p.r;
         g = p.g;
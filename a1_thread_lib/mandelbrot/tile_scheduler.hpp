@@ -0,0 +1,119 @@
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#ifndef _TILE_SCHEDULER_
+#define _TILE_SCHEDULER_
+
+/**
+ * Rectangular part of the image, [x0, x1) x [y0, y1)
+*/
+struct Tile {
+    int x0, y0, x1, y1;
+};
+
+/**
+ * Work-stealing scheduler for tiles
+ *
+ * Every thread owns a deque of tiles. The owner pops from the back of its
+ * own deque, an idle thread steals from the front of the others, so threads
+ * balance themselves on uneven regions of the fractal.
+ *
+ * Tiles can also be pushed while the threads are running (e.g. sub-rectangles
+ * of a subdivision). Every tile returned by next() has to be finished with
+ * done(); next() only gives up once no tile is queued or being worked on.
+*/
+class TileScheduler {
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Tile> tiles;
+    };
+
+    std::vector<Queue> queues;
+
+    // tiles queued or handed out but not finished yet
+    std::atomic<size_t> pending{0};
+
+public:
+    // starts without any tiles, they are pushed later on
+    TileScheduler(int num_threads) : queues(num_threads) { }
+
+    TileScheduler(int width, int height, int tile_size, int num_threads) : queues(num_threads) {
+        if (tile_size < 1)
+            tile_size = 1;
+
+        int tiles_x = (width + tile_size - 1) / tile_size;
+        int tiles_y = (height + tile_size - 1) / tile_size;
+        size_t num_tiles = (size_t)tiles_x * tiles_y;
+
+        // every thread starts with a contiguous block of tiles, so neighbouring
+        // tiles stay on the same core until someone has to steal them
+        for (size_t t = 0; t < num_tiles; t++) {
+            int tx = t % tiles_x;
+            int ty = t / tiles_x;
+
+            Tile tile{tx * tile_size, ty * tile_size,
+                      std::min((tx + 1) * tile_size, width),
+                      std::min((ty + 1) * tile_size, height)};
+
+            queues[t * num_threads / num_tiles].tiles.push_back(tile);
+        }
+        pending = num_tiles;
+    }
+
+    void push(int thread_id, const Tile& tile) {
+        pending++;
+        std::lock_guard<std::mutex> guard(queues[thread_id].mutex);
+        queues[thread_id].tiles.push_back(tile);
+    }
+
+    // marks a tile returned by next() as finished
+    void done() {
+        pending--;
+    }
+
+    // fetches the next tile for the given thread, returns false once all tiles are gone
+    bool next(int thread_id, Tile& tile) {
+        while (true) {
+            if (try_next(thread_id, tile))
+                return true;
+
+            // nothing to steal, but running tiles may still push new ones
+            if (pending.load() == 0)
+                return false;
+
+            std::this_thread::yield();
+        }
+    }
+
+private:
+    bool try_next(int thread_id, Tile& tile) {
+        {
+            std::lock_guard<std::mutex> guard(queues[thread_id].mutex);
+            auto& own = queues[thread_id].tiles;
+            if (!own.empty()) {
+                tile = own.back();
+                own.pop_back();
+                return true;
+            }
+        }
+
+        // own deque is empty, try to steal from the others
+        for (size_t i = 1; i < queues.size(); i++) {
+            auto& victim = queues[(thread_id + i) % queues.size()];
+            std::lock_guard<std::mutex> guard(victim.mutex);
+            if (!victim.tiles.empty()) {
+                tile = victim.tiles.front();
+                victim.tiles.pop_front();
+                return true;
+            }
+        }
+
+        return false;
+    }
+};
+
+#endif
@@ -0,0 +1,87 @@
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#ifndef _WORKER_POOL_
+#define _WORKER_POOL_
+
+/**
+ * Fixed set of threads that stay alive between jobs
+ *
+ * run() hands the same job to every thread (with its thread id) and returns
+ * once all of them have finished it, just like spawning and joining threads,
+ * but without creating them again for every frame of an animation.
+*/
+class WorkerPool {
+    std::vector<std::thread> threads;
+
+    std::mutex mutex;
+    std::condition_variable start_cv;
+    std::condition_variable done_cv;
+
+    std::function<void(int)> job;
+    size_t generation = 0; // incremented for every job
+    int running = 0;
+    bool stopping = false;
+
+public:
+    explicit WorkerPool(int num_threads) {
+        for (int i = 0; i < std::max(1, num_threads); i++)
+            threads.emplace_back(&WorkerPool::loop, this, i);
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            stopping = true;
+        }
+        start_cv.notify_all();
+        for (auto& t : threads)
+            t.join();
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    int size() const {
+        return threads.size();
+    }
+
+    // runs job(thread_id) on every thread of the pool and waits for all of them
+    void run(const std::function<void(int)>& job) {
+        std::unique_lock<std::mutex> lock(mutex);
+        this->job = job;
+        running = threads.size();
+        generation++;
+        start_cv.notify_all();
+        done_cv.wait(lock, [&]() { return running == 0; });
+        this->job = nullptr;
+    }
+
+private:
+    void loop(int thread_id) {
+        size_t seen = 0;
+        while (true) {
+            std::function<void(int)> current;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                start_cv.wait(lock, [&]() { return stopping || generation != seen; });
+                if (stopping)
+                    return;
+                seen = generation;
+                current = job;
+            }
+
+            current(thread_id);
+
+            std::lock_guard<std::mutex> guard(mutex);
+            if (--running == 0)
+                done_cv.notify_all();
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,238 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "../a1_thread_lib/mandelbrot/helper.hpp"
+#include "../a1_thread_lib/mandelbrot/mandelbrot.hpp"
+
+#include "mpi.h"
+
+using namespace std;
+
+/**
+ * Distributed Mandelbrot with dynamic tile dispatch
+ *
+ * Rank 0 is the coordinator: it hands out one tile at a time to whichever
+ * rank asks for work, so ranks that hit cheap regions simply come back
+ * sooner. The other ranks render their tiles with the threaded kernel of
+ * a1_thread_lib (one persistent worker pool per rank) and either send the
+ * escape counts back, where rank 0 assembles and colorizes the frame, or
+ * with --mpi-io colorize the tile themselves and write its rows straight
+ * into the shared ppm with MPI-IO. With a single process rank 0 renders all
+ * tiles itself.
+*/
+
+enum Tag {
+    TAG_REQUEST = 1, // worker is idle, no payload
+    TAG_DONE,        // worker finished its tile, payload: pixels inside
+    TAG_COUNTS,      // escape counts of the finished tile (gather mode)
+    TAG_SMOOTH,      // smooth counts of the finished tile (gather mode, smooth coloring)
+    TAG_TILE,        // next tile for the worker: x0, y0, x1, y1
+    TAG_STOP         // no tiles left
+};
+
+// tiles in row-major order
+vector<Tile> make_tiles(int width, int height, int tile_size) {
+    vector<Tile> tiles;
+    for (int y = 0; y < height; y += tile_size)
+        for (int x = 0; x < width; x += tile_size)
+            tiles.push_back({x, y, min(x + tile_size, width), min(y + tile_size, height)});
+    return tiles;
+}
+
+// copies a finished tile into the frame's escape data
+void store_tile(IterationBuffer& frame, const Tile& tile, const uint16_t* counts, const float* smooth) {
+    int cols = tile.x1 - tile.x0;
+    for (int y = tile.y0; y < tile.y1; y++) {
+        size_t row = (size_t)(y - tile.y0) * cols;
+        copy(counts + row, counts + row + cols, &frame[y][tile.x0]);
+        if (smooth)
+            copy(smooth + row, smooth + row + cols, &frame.smooth[(size_t)y * frame.width + tile.x0]);
+    }
+}
+
+// writes the rows of a colored tile at their offsets in the ppm
+void write_tile(MPI_File file, MPI_Offset header, int width, const Tile& tile, Image& pixels) {
+    int cols = tile.x1 - tile.x0;
+    for (int y = tile.y0; y < tile.y1; y++) {
+        MPI_Offset offset = header + ((MPI_Offset)y * width + tile.x0) * sizeof(Pixel);
+        MPI_File_write_at(file, offset, pixels[y - tile.y0], cols * sizeof(Pixel), MPI_BYTE, MPI_STATUS_IGNORE);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int numprocs, rank;
+    MPI_Init(&argc, &argv);
+    MPI_Comm_size(MPI_COMM_WORLD, &numprocs);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    // arguments, threads are per rank
+    int num_threads = 1;
+    int max_iterations = 2048;
+    int print_level = 1;
+    int width = 512, height = 384;
+    bool mpi_io = false;
+
+    helper::Options options;
+    options.tile_size = 64;
+    options.color = "iterations";
+
+    helper::parse_args(argc, argv, num_threads, height, width, max_iterations, print_level);
+    helper::parse_options(argc, argv, options);
+    for (int i = 1; i < argc; ++i) {
+        if ( std::string(argv[i]).compare("--mpi-io") == 0 )
+            mpi_io = true;
+    }
+    bool smooth = options.color == "smooth";
+
+    if ( rank == 0 && print_level >= 1 )
+        cout << "Generating Mandelbrot for " << width << "x" << height << " image (max iterations: " << max_iterations << ") with "
+             << numprocs << " processes x " << num_threads << " threads, tiles of " << options.tile_size << " pixels.\n";
+
+    // every rank knows the whole view, but only keeps the escape data of its tiles
+    Mandelbrot mb(height, width, max_iterations, true);
+    mb.set_isa(kernel::parse_isa(options.isa));
+    mb.set_interior_checks(options.interior == "analytic" || options.interior == "all",
+                           options.interior == "periodicity" || options.interior == "all");
+    if (!options.center_re.empty())
+        mb.set_view(options.center_re, options.center_im, options.scale);
+    mb.set_precision(kernel::parse_precision(options.precision));
+
+    vector<Tile> tiles = make_tiles(width, height, options.tile_size);
+    Palette palette = Palette::gradient();
+
+    MPI_File file;
+    std::string header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+    if (mpi_io) {
+        MPI_File_open(MPI_COMM_WORLD, "mandelbrot.ppm", MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file);
+        MPI_File_set_size(file, header.size() + (MPI_Offset)width * height * sizeof(Pixel));
+        if (rank == 0)
+            MPI_File_write_at(file, 0, header.data(), header.size(), MPI_CHAR, MPI_STATUS_IGNORE);
+    }
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    auto time_1 = MPI_Wtime();
+
+    unsigned long long pixels_inside = 0;
+    IterationBuffer frame;
+    vector<int> tiles_per_rank(numprocs, 0);
+
+    WorkerPool pool(num_threads);
+    mb.set_pool(&pool);
+
+    if (rank == 0) {
+        if (!mpi_io)
+            frame = IterationBuffer(height, width, max_iterations, smooth);
+
+        if (numprocs == 1) {
+            // nobody to dispatch to, render everything here
+            IterationBuffer tile_data(options.tile_size, options.tile_size, max_iterations, smooth);
+            Image pixels(0, 0);
+            for (const Tile& tile : tiles) {
+                pixels_inside += mb.compute_region(tile_data, tile, num_threads);
+                if (mpi_io) {
+                    pixels = Image(tile.y1 - tile.y0, tile.x1 - tile.x0);
+                    colorize(tile_data, pixels, palette);
+                    write_tile(file, header.size(), width, tile, pixels);
+                } else {
+                    store_tile(frame, tile, tile_data.counts.data(), smooth ? tile_data.smooth.data() : nullptr);
+                }
+            }
+            tiles_per_rank[0] = tiles.size();
+        } else {
+            // coordinator: answer every request or result with the next tile
+            vector<int> assigned(numprocs, -1);
+            vector<uint16_t> counts;
+            vector<float> smooth_counts;
+            size_t next_tile = 0;
+            int active = numprocs - 1;
+
+            while (active > 0) {
+                unsigned long long inside = 0;
+                MPI_Status status;
+                MPI_Recv(&inside, 1, MPI_UNSIGNED_LONG_LONG, MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
+                int worker = status.MPI_SOURCE;
+
+                if (status.MPI_TAG == TAG_DONE) {
+                    const Tile& tile = tiles[assigned[worker]];
+                    pixels_inside += inside;
+                    tiles_per_rank[worker]++;
+
+                    if (!mpi_io) {
+                        int size = (tile.x1 - tile.x0) * (tile.y1 - tile.y0);
+                        counts.resize(size);
+                        MPI_Recv(counts.data(), size, MPI_UNSIGNED_SHORT, worker, TAG_COUNTS, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+                        if (smooth) {
+                            smooth_counts.resize(size);
+                            MPI_Recv(smooth_counts.data(), size, MPI_FLOAT, worker, TAG_SMOOTH, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+                        }
+                        store_tile(frame, tile, counts.data(), smooth ? smooth_counts.data() : nullptr);
+                    }
+                }
+
+                if (next_tile < tiles.size()) {
+                    assigned[worker] = next_tile;
+                    MPI_Send(&tiles[next_tile++], 4, MPI_INT, worker, TAG_TILE, MPI_COMM_WORLD);
+                } else {
+                    MPI_Send(nullptr, 0, MPI_INT, worker, TAG_STOP, MPI_COMM_WORLD);
+                    active--;
+                }
+            }
+        }
+    } else {
+        IterationBuffer tile_data(options.tile_size, options.tile_size, max_iterations, smooth);
+        Image pixels(0, 0);
+
+        MPI_Send(nullptr, 0, MPI_UNSIGNED_LONG_LONG, 0, TAG_REQUEST, MPI_COMM_WORLD);
+        while (true) {
+            Tile tile;
+            MPI_Status status;
+            MPI_Recv(&tile, 4, MPI_INT, 0, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
+            if (status.MPI_TAG == TAG_STOP)
+                break;
+
+            unsigned long long inside = mb.compute_region(tile_data, tile, num_threads);
+            if (mpi_io) {
+                pixels = Image(tile.y1 - tile.y0, tile.x1 - tile.x0);
+                colorize(tile_data, pixels, palette);
+                write_tile(file, header.size(), width, tile, pixels);
+            }
+
+            MPI_Send(&inside, 1, MPI_UNSIGNED_LONG_LONG, 0, TAG_DONE, MPI_COMM_WORLD);
+            if (!mpi_io) {
+                MPI_Send(tile_data.counts.data(), tile_data.counts.size(), MPI_UNSIGNED_SHORT, 0, TAG_COUNTS, MPI_COMM_WORLD);
+                if (smooth)
+                    MPI_Send(tile_data.smooth.data(), tile_data.smooth.size(), MPI_FLOAT, 0, TAG_SMOOTH, MPI_COMM_WORLD);
+            }
+        }
+    }
+
+    mb.set_pool(nullptr);
+
+    // the time includes writing the image in both modes
+    if (mpi_io) {
+        MPI_File_close(&file);
+    } else if (rank == 0) {
+        Image image(height, width);
+        colorize(frame, image, palette, num_threads);
+        image.save_to_ppm("mandelbrot.ppm", PpmFormat::Binary, num_threads);
+    }
+    auto time_2 = MPI_Wtime();
+
+    if (rank == 0) {
+        cout << "Total Mandelbrot pixels: " << pixels_inside << endl;
+        if ( print_level >= 1 ) {
+            cout << "Tiles per rank:";
+            for (int r = 0; r < numprocs; r++)
+                cout << " " << tiles_per_rank[r];
+            cout << endl;
+        }
+        if ( print_level >= 1 ) cout << std::fixed << std::setprecision(4) << (time_2 - time_1) << endl;
+    }
+
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,167 @@
+#!/bin/bash
+#
+# Scaling benchmark for the Mandelbrot renderer and the histogram programs
+#
+# Builds the programs, then for every program, problem size and thread count
+# runs warm-up rounds followed by repeated timed trials. Reports median, min,
+# mean and standard deviation of the trials plus speedup and parallel
+# efficiency against the first thread count, as CSV and JSON. Needs only
+# bash, awk and a C++ compiler, no job scheduler.
+#
+# Usage: ./benchmark.sh [--programs a,b,...] [--threads "1 2 4 8"]
+#                       [--mandelbrot-sizes "512x384 1024x768"] [--histogram-sizes "10000000 30000000"]
+#                       [--mandelbrot-args "<extra options>"] [--warmup <n>] [--repeats <n>]
+#                       [--csv <file>] [--json <file>] [--build-dir <dir>]
+#
+# Programs: mandelbrot histogram histogram-atomic-mutex histogram-best histogram-strategies
+#           omp-histo-test-best omp-histogram-v1-best omp-histogram-v1-naive
+# The OpenMP programs have a fixed problem size, only their threads are swept.
+# histogram is sequential, only its sizes are swept, with one thread.
+# A program that does not compile is skipped with a warning.
+
+set -e
+
+ROOT=$(cd "$(dirname "$0")" && pwd)
+
+PROGRAMS="mandelbrot,histogram,histogram-atomic-mutex,histogram-best,omp-histogram-v1-best"
+THREADS="1 2 4 8"
+MANDELBROT_SIZES="512x384 1024x768"
+HISTOGRAM_SIZES="10000000 30000000"
+MANDELBROT_ARGS=""
+WARMUP=1
+REPEATS=5
+CSV="benchmark.csv"
+JSON="benchmark.json"
+BUILD_DIR="$ROOT/_bench_build"
+CXX=${CXX:-g++}
+
+while [ $# -gt 0 ]; do
+    case "$1" in
+        --programs) PROGRAMS="$2"; shift ;;
+        --threads) THREADS="$2"; shift ;;
+        --mandelbrot-sizes) MANDELBROT_SIZES="$2"; shift ;;
+        --histogram-sizes) HISTOGRAM_SIZES="$2"; shift ;;
+        --mandelbrot-args) MANDELBROT_ARGS="$2"; shift ;;
+        --warmup) WARMUP="$2"; shift ;;
+        --repeats) REPEATS="$2"; shift ;;
+        --csv) CSV="$2"; shift ;;
+        --json) JSON="$2"; shift ;;
+        --build-dir) BUILD_DIR="$2"; shift ;;
+        --help) sed -n '2,20p' "$0"; exit 0 ;;
+        *) echo "Unknown option $1"; exit 1 ;;
+    esac
+    shift
+done
+
+mkdir -p "$BUILD_DIR"
+
+# source file of a program
+source_of() {
+    case "$1" in
+        mandelbrot) echo "$ROOT/a1_thread_lib/mandelbrot/main.cpp" ;;
+        histogram|histogram-atomic-mutex|histogram-best|histogram-strategies) echo "$ROOT/a1_thread_lib/histogram/$1.cpp" ;;
+        omp-*) echo "$ROOT/a2_omp/${1#omp-}.cpp" ;;
+        *) echo "Unknown program $1" >&2; exit 1 ;;
+    esac
+}
+
+# problem sizes of a program
+sizes_of() {
+    case "$1" in
+        mandelbrot) echo "$MANDELBROT_SIZES" ;;
+        omp-*) echo "default" ;;
+        *) echo "$HISTOGRAM_SIZES" ;;
+    esac
+}
+
+# thread counts of a program, one for the sequential ones
+threads_of() {
+    case "$1" in
+        histogram) echo "1" ;;
+        *) echo "$THREADS" ;;
+    esac
+}
+
+# one run, prints the measured time in seconds
+run_once() {
+    local program=$1 size=$2 threads=$3 binary="$BUILD_DIR/$1"
+    case "$program" in
+        mandelbrot)
+            (cd "$BUILD_DIR" && "$binary" --num-threads "$threads" --width "${size%x*}" --height "${size#*x}" --print-level 1 $MANDELBROT_ARGS) | tail -n 1 ;;
+        omp-*)
+            OMP_NUM_THREADS=$threads "$binary" | awk '/time elapsed/ { print $3 }' ;;
+        *)
+            "$binary" --num-threads "$threads" --sample-size "$size" --print-level 0 | tail -n 1 ;;
+    esac
+}
+
+# median, min, mean and stddev of the numbers on stdin
+statistics() {
+    sort -g | awk '
+        { t[NR] = $1; sum += $1 }
+        END {
+            mean = sum / NR
+            for (i = 1; i <= NR; i++) var += (t[i] - mean) ^ 2
+            median = NR % 2 ? t[(NR + 1) / 2] : (t[NR / 2] + t[NR / 2 + 1]) / 2
+            stddev = NR > 1 ? sqrt(var / (NR - 1)) : 0
+            printf "%.6f %.6f %.6f %.6f\n", median, t[1], mean, stddev
+        }'
+}
+
+echo "program,size,threads,repeats,median,min,mean,stddev,speedup,efficiency" > "$CSV"
+
+for PROGRAM in ${PROGRAMS//,/ }; do
+    echo "Building $PROGRAM"
+    FLAGS="-O2 -std=c++17 -pthread"
+    case "$PROGRAM" in omp-*) FLAGS="$FLAGS -fopenmp" ;; esac
+    if ! $CXX $FLAGS "$(source_of "$PROGRAM")" -o "$BUILD_DIR/$PROGRAM"; then
+        echo "Warning: $PROGRAM does not build, skipping it" >&2
+        continue
+    fi
+
+    for SIZE in $(sizes_of "$PROGRAM"); do
+        BASE_TIME=""
+        BASE_THREADS=""
+
+        for THREAD_COUNT in $(threads_of "$PROGRAM"); do
+            for ((i = 0; i < WARMUP; i++)); do
+                run_once "$PROGRAM" "$SIZE" "$THREAD_COUNT" > /dev/null
+            done
+
+            TIMES=""
+            for ((i = 0; i < REPEATS; i++)); do
+                TIMES="$TIMES $(run_once "$PROGRAM" "$SIZE" "$THREAD_COUNT")"
+            done
+
+            read MEDIAN MIN MEAN STDDEV <<< "$(echo $TIMES | tr ' ' '\n' | statistics)"
+
+            # speedup and efficiency against the first thread count of the sweep
+            if [ -z "$BASE_TIME" ]; then
+                BASE_TIME=$MEDIAN
+                BASE_THREADS=$THREAD_COUNT
+            fi
+            read SPEEDUP EFFICIENCY <<< "$(awk -v b="$BASE_TIME" -v m="$MEDIAN" -v bt="$BASE_THREADS" -v t="$THREAD_COUNT" \
+                'BEGIN { s = m > 0 ? b / m : 0; printf "%.3f %.3f\n", s, s * bt / t }')"
+
+            printf "%-24s %-10s threads %3s  median %9s  min %9s  stddev %9s  speedup %6s  efficiency %6s\n" \
+                "$PROGRAM" "$SIZE" "$THREAD_COUNT" "$MEDIAN" "$MIN" "$STDDEV" "$SPEEDUP" "$EFFICIENCY"
+            echo "$PROGRAM,$SIZE,$THREAD_COUNT,$REPEATS,$MEDIAN,$MIN,$MEAN,$STDDEV,$SPEEDUP,$EFFICIENCY" >> "$CSV"
+        done
+    done
+done
+
+# the same rows as a json array
+awk -F, '
+    NR == 1 { for (i = 1; i <= NF; i++) key[i] = $i; print "["; next }
+    {
+        if (NR > 2) print ","
+        printf "  {"
+        for (i = 1; i <= NF; i++) {
+            value = (i <= 2) ? "\"" $i "\"" : $i
+            printf "%s\"%s\": %s", (i > 1 ? ", " : ""), key[i], value
+        }
+        printf "}"
+    }
+    END { print "\n]" }' "$CSV" > "$JSON"
+
+echo "Results written to $CSV and $JSON"